@@ -9,7 +9,6 @@
 #include <stdio.h>
 #include <iostream>
 #include <string>
-#include <io.h>
 #include <unistd.h>
 
 #include "audio.h"
@@ -65,26 +64,31 @@ int audio_init(int sampling_rate, const std::string device_name)
 void audio_tx( int fd, int sampling_rate, int *lt_channel, int *rt_channel, int n_samples )
 {
     double CHUNK_TIME = 0.005;
+    const int CHUNK_MAX = 1024;
+    short buffer[CHUNK_MAX * 2];
+
     int chunk_size = (int)(sampling_rate * CHUNK_TIME);
-    short * buffer = new short[chunk_size * 2];
+    if ( chunk_size > CHUNK_MAX ) chunk_size = CHUNK_MAX;
+    if ( chunk_size < 1 ) chunk_size = 1;
 
     for (int i = 0; i < n_samples; i += chunk_size)
     {
-        for (int j = 0; j < chunk_size; j++)
+        // the last chunk holds whatever is left
+        const int count = (n_samples - i < chunk_size) ? n_samples - i : chunk_size;
+
+        for (int j = 0; j < count; j++)
         {
             buffer[2*j+0] = (short)lt_channel[j];
             buffer[2*j+1] = (short)rt_channel[j];
         }
 
-        lt_channel += chunk_size;
-        rt_channel += chunk_size;
+        lt_channel += count;
+        rt_channel += count;
         
-        if ( write(fd, buffer, 2*chunk_size*sizeof(short)) < 0 )
+        if ( write(fd, buffer, 2*count*sizeof(short)) < 0 )
         {
             printf( "Failed to write audio output!\n" );
             return;
         }
     }
-
-    delete buffer;
 }
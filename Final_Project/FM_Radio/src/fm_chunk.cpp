@@ -0,0 +1,83 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fm_radio.h"
+#include "fm_pool.h"
+#include "fm_chunk.h"
+
+
+struct chunk_task
+{
+    const uint8_t *iq;
+    size_t warm;        // first sample of the warm-up window
+    size_t start;       // first sample of the segment
+    size_t end;         // one past the last sample of the segment
+    int *left;          // output of sample start
+    int *right;
+};
+
+static void chunk_decode( void *arg )
+{
+    chunk_task *t = (chunk_task *)arg;
+    FmReceiver rx( GRAPH_TILE );
+
+    // warm-up output is discarded
+    const size_t n_warm = t->start - t->warm;
+    if ( n_warm > 0 )
+    {
+        int *scratch = new int[2 * (n_warm / AUDIO_DECIM)];
+        rx.process( &t->iq[t->warm * 4], n_warm, scratch, &scratch[n_warm / AUDIO_DECIM] );
+        delete [] scratch;
+    }
+
+    rx.process( &t->iq[t->start * 4], t->end - t->start, t->left, t->right );
+}
+
+int fm_decode_chunks( const uint8_t *iq, size_t n, int *left, int *right, int segments, int iir_warmup )
+{
+    const size_t total = n - (n % AUDIO_DECIM);
+    const size_t warmup = FM_CHUNK_FIR_WARMUP + (size_t)iir_warmup * AUDIO_DECIM;
+
+    if ( segments > FM_POOL_MAX_TASKS ) segments = FM_POOL_MAX_TASKS;
+    if ( segments < 1 ) segments = 1;
+
+    // segments shorter than their warm-up do not pay off
+    while ( segments > 1 && total / segments < warmup )
+    {
+        segments--;
+    }
+
+    chunk_task tasks[FM_POOL_MAX_TASKS];
+    fm_task fn[FM_POOL_MAX_TASKS];
+    void *args[FM_POOL_MAX_TASKS];
+
+    const size_t groups = total / AUDIO_DECIM;
+    for ( int k = 0; k < segments; k++ )
+    {
+        chunk_task *t = &tasks[k];
+        t->iq    = iq;
+        t->start = groups * k / segments * AUDIO_DECIM;
+        t->end   = groups * (k + 1) / segments * AUDIO_DECIM;
+        t->warm  = (t->start > warmup) ? t->start - warmup : 0;
+        t->left  = &left[t->start / AUDIO_DECIM];
+        t->right = &right[t->start / AUDIO_DECIM];
+        fn[k]    = chunk_decode;
+        args[k]  = t;
+    }
+
+    // the first segment starts from the zero state, like a sequential run
+    tasks[0].warm = 0;
+
+    if ( segments == 1 )
+    {
+        chunk_decode( &tasks[0] );
+    }
+    else
+    {
+        FmPool pool( segments - 1 );
+        pool.run( fn, args, segments );
+    }
+
+    return (int)groups;
+}
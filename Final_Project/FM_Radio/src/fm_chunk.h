@@ -0,0 +1,41 @@
+#ifndef __FM_CHUNK_H__
+#define __FM_CHUNK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fm_radio.h"
+
+// -------------------------------------------------------
+// Chunk-parallel decode of one capture.
+//
+// The capture is cut into K segments on AUDIO_DECIM
+// boundaries, so every decimating filter keeps its phase.
+// Each segment is decoded by its own FmReceiver, which first
+// runs over a warm-up window in front of the segment and
+// throws that output away:
+//
+//   FIR chain  - channel, demod, BP/pilot, HP, AUDIO_LPR/LMR
+//                have finite memory; FM_CHUNK_FIR_WARMUP
+//                samples fill every delay line with real data,
+//                after which the output is bit-exact
+//   deemphasis - the IIR (pole ~ -0.65) never forgets exactly;
+//                a state error shrinks by 0.65 per audio sample
+//                and the integer truncation absorbs it once it
+//                drops below 1 LSB. iir_warmup audio samples of
+//                settling make the stitched output exact on
+//                every capture tried (random input settles in
+//                under 40); in the worst case a segment head may
+//                differ by a few LSB for a few samples.
+// -------------------------------------------------------
+
+#define FM_CHUNK_FIR_WARMUP     (8 * MAX_TAPS)  // I/Q samples, covers channel + demod + 3 FIR stages
+#define FM_CHUNK_IIR_WARMUP     256             // audio samples of deemphasis settling
+
+// Decodes n I/Q pairs into n / AUDIO_DECIM left / right samples using
+// segments threads (1 = plain sequential decode). Returns the number of
+// audio samples written per channel.
+int fm_decode_chunks( const uint8_t *iq, size_t n, int *left, int *right, int segments,
+                      int iir_warmup = FM_CHUNK_IIR_WARMUP );
+
+#endif
@@ -0,0 +1,276 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fm_dump.h"
+#include "fm_io.h"
+
+#define EXPORT_BUFFER   (1 << 20)
+#define EXPORT_LINE     16          // longest line: "-2147483648\n"
+
+
+static void encode_header( unsigned char *h, const fm_dump_info *info )
+{
+    memset( h, 0, FM_DUMP_HEADER );
+    memcpy( &h[0], FM_DUMP_MAGIC, 4 );
+    fm_put_le( &h[4], FM_DUMP_VERSION, 4 );
+    memcpy( &h[8], info->name, FM_DUMP_NAME );
+    fm_put_le( &h[40], (uint32_t)info->rate, 4 );
+    fm_put_le( &h[44], (uint32_t)info->frac_bits, 4 );
+    fm_put_le( &h[48], (uint64_t)info->start, 8 );
+    fm_put_le( &h[56], (uint64_t)info->length, 8 );
+}
+
+
+// -------------------------------------------------------
+// writer
+// -------------------------------------------------------
+
+int fm_dump_open( fm_dump *d, const char *path, const char *name, int rate, int frac_bits, int64_t start )
+{
+    memset( d, 0, sizeof(*d) );
+    strncpy( d->info.name, name, FM_DUMP_NAME - 1 );
+    d->info.rate = rate;
+    d->info.frac_bits = frac_bits;
+    d->info.start = start;
+
+    d->fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( d->fd < 0 )
+    {
+        fprintf( stderr, "Unable to open %s\n", path );
+        return -1;
+    }
+
+    // header with length 0 until close
+    d->buf = new unsigned char[FM_DUMP_BUFFER];
+    encode_header( d->buf, &d->info );
+    d->buf_used = FM_DUMP_HEADER;
+    return 0;
+}
+
+static void flush_buf( fm_dump *d )
+{
+    if ( d->buf_used > 0 && fm_write_all( d->fd, d->buf, d->buf_used ) != 0 )
+    {
+        d->error = 1;
+    }
+    d->buf_used = 0;
+}
+
+int fm_dump_write( fm_dump *d, const int *x, int n )
+{
+    while ( n > 0 )
+    {
+        int room = (FM_DUMP_BUFFER - d->buf_used) / 4;
+        if ( room == 0 )
+        {
+            flush_buf( d );
+            continue;
+        }
+
+        int m = (n < room) ? n : room;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        for ( int i = 0; i < m; i++ )
+        {
+            fm_put_le( &d->buf[d->buf_used + 4*i], (uint32_t)x[i], 4 );
+        }
+#else
+        memcpy( &d->buf[d->buf_used], x, (size_t)m * 4 );
+#endif
+        d->buf_used += m * 4;
+        d->info.length += m;
+        x += m;
+        n -= m;
+    }
+    return d->error ? -1 : 0;
+}
+
+int fm_dump_close( fm_dump *d )
+{
+    if ( d->fd < 0 ) return -1;
+
+    flush_buf( d );
+
+    unsigned char h[FM_DUMP_HEADER];
+    encode_header( h, &d->info );
+    if ( pwrite( d->fd, h, FM_DUMP_HEADER, 0 ) != FM_DUMP_HEADER )
+    {
+        d->error = 1;
+    }
+
+    close( d->fd );
+    d->fd = -1;
+    delete[] d->buf;
+    d->buf = NULL;
+    return d->error ? -1 : 0;
+}
+
+
+// -------------------------------------------------------
+// reader
+// -------------------------------------------------------
+
+int fm_dump_map( fm_dump_view *v, const char *path )
+{
+    memset( v, 0, sizeof(*v) );
+
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+    {
+        fprintf( stderr, "Unable to open %s\n", path );
+        return -1;
+    }
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size < FM_DUMP_HEADER )
+    {
+        fprintf( stderr, "%s: not a golden dump\n", path );
+        close( fd );
+        return -1;
+    }
+
+    v->map_size = (size_t)st.st_size;
+    v->map = mmap( NULL, v->map_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( v->map == MAP_FAILED )
+    {
+        fprintf( stderr, "Unable to map %s\n", path );
+        v->map = NULL;
+        return -1;
+    }
+    madvise( v->map, v->map_size, MADV_SEQUENTIAL );
+
+    const unsigned char *h = (const unsigned char *)v->map;
+    if ( memcmp( h, FM_DUMP_MAGIC, 4 ) != 0 || fm_get_le( &h[4], 4 ) != FM_DUMP_VERSION )
+    {
+        fprintf( stderr, "%s: not a version %d golden dump\n", path, FM_DUMP_VERSION );
+        fm_dump_unmap( v );
+        return -1;
+    }
+
+    memcpy( v->info.name, &h[8], FM_DUMP_NAME );
+    v->info.name[FM_DUMP_NAME - 1] = '\0';
+    v->info.rate      = (int)fm_get_le( &h[40], 4 );
+    v->info.frac_bits = (int)fm_get_le( &h[44], 4 );
+    v->info.start     = (int64_t)fm_get_le( &h[48], 8 );
+    v->info.length    = (int64_t)fm_get_le( &h[56], 8 );
+
+    if ( v->info.length < 0 || (uint64_t)v->info.length > (v->map_size - FM_DUMP_HEADER) / 4 )
+    {
+        fprintf( stderr, "%s: truncated (%lld samples in the header)\n", path, (long long)v->info.length );
+        fm_dump_unmap( v );
+        return -1;
+    }
+
+    v->data = (const int32_t *)(h + FM_DUMP_HEADER);
+    return 0;
+}
+
+void fm_dump_unmap( fm_dump_view *v )
+{
+    if ( v->map != NULL )
+    {
+        munmap( v->map, v->map_size );
+    }
+    memset( v, 0, sizeof(*v) );
+}
+
+
+// -------------------------------------------------------
+// text / $readmemh export
+// -------------------------------------------------------
+
+// decimal, newline terminated; returns the characters written
+static int format_dec( char *p, int x )
+{
+    char tmp[EXPORT_LINE];
+    unsigned int u = (x < 0) ? 0u - (unsigned int)x : (unsigned int)x;
+    int k = 0;
+
+    do
+    {
+        tmp[k++] = (char)('0' + u % 10);
+        u /= 10;
+    } while ( u != 0 );
+
+    int len = 0;
+    if ( x < 0 ) p[len++] = '-';
+    while ( k > 0 ) p[len++] = tmp[--k];
+    p[len++] = '\n';
+    return len;
+}
+
+static int format_hex( char *p, int x )
+{
+    static const char digits[] = "0123456789abcdef";
+    unsigned int u = (unsigned int)x;
+
+    for ( int i = 7; i >= 0; i-- )
+    {
+        p[i] = digits[u & 0xF];
+        u >>= 4;
+    }
+    p[8] = '\n';
+    return 9;
+}
+
+int fm_dump_export( const fm_dump_view *v, int64_t first, int64_t n, fm_dump_format format, int fd )
+{
+    char *buf = new char[EXPORT_BUFFER];
+    int used = 0;
+    int rc = 0;
+
+    if ( first < 0 ) first = 0;
+    if ( first + n > v->info.length ) n = v->info.length - first;
+
+    for ( int64_t i = first; i < first + n && rc == 0; i++ )
+    {
+        if ( used > EXPORT_BUFFER - EXPORT_LINE )
+        {
+            rc = fm_write_all( fd, buf, used );
+            used = 0;
+        }
+
+        const int x = fm_dump_sample( v, i );
+        used += (format == FM_DUMP_HEX) ? format_hex( &buf[used], x ) : format_dec( &buf[used], x );
+    }
+    if ( rc == 0 && used > 0 )
+    {
+        rc = fm_write_all( fd, buf, used );
+    }
+
+    delete[] buf;
+    return rc;
+}
+
+int fm_dump_convert( const char *in_path, const char *out_path, fm_dump_format format )
+{
+    fm_dump_view v;
+    if ( fm_dump_map( &v, in_path ) != 0 )
+    {
+        return -1;
+    }
+
+    int fd = (strcmp(out_path, "-") == 0) ? 1 : open( out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 )
+    {
+        fprintf( stderr, "Unable to open %s\n", out_path );
+        fm_dump_unmap( &v );
+        return -1;
+    }
+
+    int rc = fm_dump_export( &v, 0, v.info.length, format, fd );
+    if ( rc != 0 )
+    {
+        fprintf( stderr, "Write failed on %s\n", out_path );
+    }
+
+    if ( fd != 1 ) close( fd );
+    fm_dump_unmap( &v );
+    return rc;
+}
@@ -0,0 +1,101 @@
+#ifndef __FM_DUMP_H__
+#define __FM_DUMP_H__
+
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Binary golden dumps.
+//
+// One signal per file: a 64-byte header followed by the
+// samples as raw little-endian int32, so a dump can be
+// mmap()ed and indexed directly.
+//
+//   offset  size
+//        0     4  magic "FMGD"
+//        4     4  version (FM_DUMP_VERSION)
+//        8    32  signal name, NUL padded
+//       40     4  sample rate, Hz
+//       44     4  fractional bits of the Q format (BITS, Q14 after gain)
+//       48     8  index of the first sample in the stream
+//       56     8  number of samples
+//
+// All header fields are little-endian. Writes go through a
+// large buffer; the length is patched in on close. The text
+// ("%d" per line, as the SV testbenches read it) and the
+// $readmemh forms are produced from a dump on demand.
+// -------------------------------------------------------
+
+#define FM_DUMP_MAGIC       "FMGD"
+#define FM_DUMP_VERSION     1
+#define FM_DUMP_HEADER      64
+#define FM_DUMP_NAME        32
+#define FM_DUMP_BUFFER      (1 << 20)   // bytes buffered per open dump
+
+struct fm_dump_info
+{
+    char name[FM_DUMP_NAME];
+    int rate;
+    int frac_bits;
+    int64_t start;
+    int64_t length;
+};
+
+struct fm_dump
+{
+    int fd;
+    fm_dump_info info;
+    unsigned char *buf;
+    int buf_used;
+    int error;
+};
+
+// Returns 0, or -1 with a message on stderr.
+int fm_dump_open( fm_dump *d, const char *path, const char *name, int rate, int frac_bits, int64_t start );
+
+// returns 0, or -1 when a write failed
+int fm_dump_write( fm_dump *d, const int *x, int n );
+
+// flushes, patches the length and closes; returns -1 if any write failed
+int fm_dump_close( fm_dump *d );
+
+
+// read-only mapping of a dump
+struct fm_dump_view
+{
+    fm_dump_info info;
+    const int32_t *data;    // little-endian samples
+    void *map;
+    size_t map_size;
+};
+
+// Returns 0, or -1 with a message on stderr (missing file, bad magic or
+// version, truncated payload).
+int fm_dump_map( fm_dump_view *v, const char *path );
+void fm_dump_unmap( fm_dump_view *v );
+
+// sample i of a mapped dump
+static inline int fm_dump_sample( const fm_dump_view *v, int64_t i )
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (int)__builtin_bswap32( (uint32_t)v->data[i] );
+#else
+    return v->data[i];
+#endif
+}
+
+
+enum fm_dump_format
+{
+    FM_DUMP_TEXT,       // "%d\n" per sample, as the SV testbenches read it
+    FM_DUMP_HEX         // $readmemh: 8 hex digits (two's complement) per line
+};
+
+// Writes samples [first, first + n) of v to fd in the given format.
+// Returns 0, or -1 when a write failed.
+int fm_dump_export( const fm_dump_view *v, int64_t first, int64_t n, fm_dump_format format, int fd );
+
+// Whole dump at in_path to out_path ("-" is stdout). Returns 0, or -1 with a
+// message on stderr.
+int fm_dump_convert( const char *in_path, const char *out_path, fm_dump_format format );
+
+#endif
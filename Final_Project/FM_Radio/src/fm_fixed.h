@@ -0,0 +1,399 @@
+#ifndef __FM_FIXED_H__
+#define __FM_FIXED_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fm_radio.h"
+
+// -------------------------------------------------------
+// Fixed-point precision as a template parameter.
+//
+// The per-sample kernels, templated on the sample storage
+// type T and the fractional bits FRAC of the samples. The
+// <int, BITS> instantiation is the only copy of them:
+// fir(), fir_cmplx(), iir(), demodulate(), qarctan(),
+// multiply_n() and gain_n() in fm_radio.cpp call it.
+// Coefficients stay the Q10 (BITS) tables of fm_radio.h, so
+// a sample x coefficient product is DEQUANTIZEd by BITS and
+// keeps the sample's format; a sample x sample product
+// (demodulate, multiply) is scaled back by FRAC. Arithmetic
+// runs in fixed_traits<T>::acc and is stored back into T:
+//
+//   int       int32 storage, int32 arithmetic. With FRAC =
+//             BITS these are fm_radio.cpp's kernels.
+//   int16_t   int16 storage (half the delay line and block
+//             memory), int32 arithmetic, saturating stores
+//   double    no rounding anywhere: the float reference the
+//             integer configurations are measured against
+//
+// The input is QUANTIZEd to FRAC and then shifted right by
+// in_shift, which buys headroom: every sample x sample
+// product has to fit the int32 accumulator, and the int16
+// path has to fit its samples into 16 bits. The audio comes
+// out of the gain stage in the Q14 scale of gain_n() for
+// every FRAC, so outputs of all configurations compare.
+// -------------------------------------------------------
+
+template <typename T> struct fixed_traits;
+
+template <> struct fixed_traits<int>
+{
+    typedef int acc;
+    static int store( int v ) { return v; }
+    static int scale( int v, int frac ) { return v * (1 << frac); }
+    static int descale( int v, int frac ) { return v / (1 << frac); }
+};
+
+template <> struct fixed_traits<int16_t>
+{
+    typedef int acc;
+    static int16_t store( int v ) { return (int16_t)((v > 32767) ? 32767 : (v < -32768) ? -32768 : v); }
+    static int scale( int v, int frac ) { return v * (1 << frac); }
+    static int descale( int v, int frac ) { return v / (1 << frac); }
+};
+
+template <> struct fixed_traits<double>
+{
+    typedef double acc;
+    static double store( double v ) { return v; }
+    static double scale( double v, int frac ) { return v * (double)(1 << frac); }
+    static double descale( double v, int frac ) { return v / (double)(1 << frac); }
+};
+
+
+// deinterleave, QUANTIZE to FRAC and shift right by in_shift
+template <typename T, int FRAC>
+void fixed_read_IQ( const unsigned char *IQ, const int samples, const int in_shift, T *I, T *Q )
+{
+    typedef fixed_traits<T> tr;
+    int i = 0;
+
+    for ( i = 0; i < samples; i++ )
+    {
+        const short re = (short)(IQ[i*4+1] << 8 | IQ[i*4+0]);
+        const short im = (short)(IQ[i*4+3] << 8 | IQ[i*4+2]);
+        I[i] = tr::store( tr::descale( tr::scale( (typename tr::acc)re, FRAC ), in_shift ) );
+        Q[i] = tr::store( tr::descale( tr::scale( (typename tr::acc)im, FRAC ), in_shift ) );
+    }
+}
+
+template <typename T, int FRAC>
+typename fixed_traits<T>::acc fixed_qarctan( typename fixed_traits<T>::acc y, typename fixed_traits<T>::acc x )
+{
+    typedef fixed_traits<T> tr;
+    typedef typename tr::acc acc;
+    const acc quad1 = (acc)((float)(PI / 4.0) * (float)(1 << FRAC));
+    const acc quad3 = (acc)((float)(3.0 * PI / 4.0) * (float)(1 << FRAC));
+
+    acc abs_y = ((y < 0) ? -y : y) + 1;
+    acc angle = 0;
+    acc r = 0;
+
+    if ( x >= 0 )
+    {
+        r = tr::scale( x - abs_y, FRAC ) / (x + abs_y);
+        angle = quad1 - tr::descale( quad1 * r, FRAC );
+    }
+    else
+    {
+        r = tr::scale( x + abs_y, FRAC ) / (abs_y - x);
+        angle = quad3 - tr::descale( quad1 * r, FRAC );
+    }
+
+    return ((y < 0) ? -angle : angle);
+}
+
+// gain is a Q10 coefficient (FM_DEMOD_GAIN)
+template <typename T, int FRAC>
+void fixed_demodulate( T real, T imag, T *real_prev, T *imag_prev, const int gain, T *demod_out )
+{
+    typedef fixed_traits<T> tr;
+    typedef typename tr::acc acc;
+
+    // k * atan(c1 * conj(c0))
+    acc r = tr::descale( (acc)*real_prev * real, FRAC ) - tr::descale( -(acc)*imag_prev * imag, FRAC );
+    acc i = tr::descale( (acc)*real_prev * imag, FRAC ) + tr::descale( -(acc)*imag_prev * real, FRAC );
+
+    *demod_out = tr::store( tr::descale( gain * fixed_qarctan<T, FRAC>( i, r ), BITS ) );
+
+    *real_prev = real;
+    *imag_prev = imag;
+}
+
+template <typename T, int FRAC>
+void fixed_fir( const T *x_in, const int *coeff, T *x, const int taps, const int decimation, T *y_out )
+{
+    typedef fixed_traits<T> tr;
+    typename tr::acc y = 0;
+    int i = 0;
+    int j = 0;
+
+    // shift x
+    for ( j = taps-1; j > decimation-1; j-- )
+    {
+        x[j] = x[j-decimation];
+    }
+
+    for ( i = 0; i < decimation; i++ )
+    {
+        x[decimation-i-1] = x_in[i];
+    }
+
+    for ( j = 0; j < taps; j++ )
+    {
+        y += tr::descale( coeff[taps-j-1] * (typename tr::acc)x[j], BITS );
+    }
+
+    *y_out = tr::store( y );
+}
+
+template <typename T, int FRAC>
+void fixed_fir_cmplx( const T *x_real_in, const T *x_imag_in, const int *h_real, const int *h_imag, T *x_real, T *x_imag,
+                      const int taps, const int decimation, T *y_real_out, T *y_imag_out )
+{
+    typedef fixed_traits<T> tr;
+    typedef typename tr::acc acc;
+    acc y_real = 0;
+    acc y_imag = 0;
+    int i = 0;
+    int j = 0;
+
+    // shift x
+    for ( j = taps-1; j > decimation-1; j-- )
+    {
+        x_real[j] = x_real[j-decimation];
+        x_imag[j] = x_imag[j-decimation];
+    }
+
+    for ( i = 0; i < decimation; i++ )
+    {
+        x_real[decimation-i-1] = x_real_in[i];
+        x_imag[decimation-i-1] = x_imag_in[i];
+    }
+
+    // compute new real & imag values
+    for ( i = 0; i < taps; i++ )
+    {
+        y_real += tr::descale( (h_real[i] * (acc)x_real[i]) - (h_imag[i] * (acc)x_imag[i]), BITS );
+        y_imag += tr::descale( (h_real[i] * (acc)x_imag[i]) - (h_imag[i] * (acc)x_real[i]), BITS );
+    }
+
+    *y_real_out = tr::store( y_real );
+    *y_imag_out = tr::store( y_imag );
+}
+
+template <typename T, int FRAC>
+void fixed_iir( const T *x_in, const int *x_coeffs, const int *y_coeffs, T *x, T *y, const int taps, const int decimation, T *y_out )
+{
+    typedef fixed_traits<T> tr;
+    typename tr::acc y1 = 0;
+    typename tr::acc y2 = 0;
+    int i = 0;
+    int j = 0;
+
+    // shift x
+    for ( j = taps-1; j > decimation-1; j-- )
+    {
+        x[j] = x[j-decimation];
+    }
+
+    for ( i = 0; i < decimation; i++ )
+    {
+        x[decimation-i-1] = x_in[i];
+    }
+
+    // shift y
+    for ( j = taps-1; j > 0; j-- )
+    {
+        y[j] = y[j-1];
+    }
+
+    // get the new y
+    for ( i = 0; i < taps; i++ )
+    {
+        y1 += tr::descale( x_coeffs[i] * (typename tr::acc)x[i], BITS );
+        y2 += tr::descale( y_coeffs[i] * (typename tr::acc)y[i], BITS );
+    }
+
+    y[0] = tr::store( y1 + y2 );
+
+    *y_out = y[taps-1];
+}
+
+template <typename T, int FRAC>
+void fixed_multiply_n( const T *x_in, const T *y_in, const int n_samples, T *output )
+{
+    typedef fixed_traits<T> tr;
+    int i = 0;
+
+    for ( i = 0; i < n_samples; i++ )
+    {
+        output[i] = tr::store( tr::descale( (typename tr::acc)x_in[i] * y_in[i], FRAC ) );
+    }
+}
+
+// gain is a Q10 coefficient; the output is in the Q14 scale of gain_n()
+// whatever FRAC is, and is not stored back into T
+template <typename T, int FRAC>
+void fixed_gain_n( const T *input, const int n_samples, const int gain, typename fixed_traits<T>::acc *output )
+{
+    typedef fixed_traits<T> tr;
+    int i = 0;
+
+    for ( i = 0; i < n_samples; i++ )
+    {
+        output[i] = tr::scale( tr::descale( gain * (typename tr::acc)input[i], BITS ), 14 - FRAC );
+    }
+}
+
+
+// -------------------------------------------------------
+// The reference receiver chain (fm_golden's, with the
+// filter-based carrier) on the templated kernels.
+// -------------------------------------------------------
+
+template <typename T, int FRAC>
+class FmFixedReceiver
+{
+public:
+    typedef typename fixed_traits<T>::acc audio_t;
+
+    FmFixedReceiver( int block_samples = SAMPLES, int in_shift = 0 );
+    ~FmFixedReceiver();
+
+    // n I/Q pairs (usrp.dat format) to n / AUDIO_DECIM samples of left and
+    // right; trailing samples that do not fill an AUDIO_DECIM group are
+    // ignored. Returns the number of audio samples written per channel.
+    int process( const unsigned char *iq, size_t n, audio_t *left, audio_t *right );
+
+    void reset();
+
+    int input_shift() const { return shift; }
+
+private:
+    FmFixedReceiver( const FmFixedReceiver & );
+    FmFixedReceiver & operator=( const FmFixedReceiver & );
+
+    void process_block( const unsigned char *iq, int n, audio_t *left, audio_t *right );
+
+    int block;
+    int shift;
+
+    // delay lines, same layout as the kernels of fm_radio.cpp
+    T fir_cmplx_x_real[MAX_TAPS], fir_cmplx_x_imag[MAX_TAPS];
+    T demod_real, demod_imag;
+    T fir_lpr_x[MAX_TAPS], fir_lmr_x[MAX_TAPS], fir_bp_x[MAX_TAPS], fir_pilot_x[MAX_TAPS], fir_hp_x[MAX_TAPS];
+    T deemph_l_x[MAX_TAPS], deemph_l_y[MAX_TAPS], deemph_r_x[MAX_TAPS], deemph_r_y[MAX_TAPS];
+
+    // per-block signals
+    T *I, *Q, *I_fir, *Q_fir, *demod;
+    T *bp_pilot, *square, *carrier, *bp_lmr, *mix;
+    T *lpr, *lmr, *left_raw, *right_raw, *left_deemph, *right_deemph;
+};
+
+template <typename T, int FRAC>
+FmFixedReceiver<T, FRAC>::FmFixedReceiver( int block_samples, int in_shift )
+{
+    block = block_samples - (block_samples % AUDIO_DECIM);
+    shift = in_shift;
+
+    const int n_audio = block / AUDIO_DECIM;
+    I = new T[block]; Q = new T[block]; I_fir = new T[block]; Q_fir = new T[block]; demod = new T[block];
+    bp_pilot = new T[block]; square = new T[block]; carrier = new T[block]; bp_lmr = new T[block]; mix = new T[block];
+    lpr = new T[n_audio]; lmr = new T[n_audio]; left_raw = new T[n_audio]; right_raw = new T[n_audio];
+    left_deemph = new T[n_audio]; right_deemph = new T[n_audio];
+
+    reset();
+}
+
+template <typename T, int FRAC>
+FmFixedReceiver<T, FRAC>::~FmFixedReceiver()
+{
+    delete[] I; delete[] Q; delete[] I_fir; delete[] Q_fir; delete[] demod;
+    delete[] bp_pilot; delete[] square; delete[] carrier; delete[] bp_lmr; delete[] mix;
+    delete[] lpr; delete[] lmr; delete[] left_raw; delete[] right_raw;
+    delete[] left_deemph; delete[] right_deemph;
+}
+
+template <typename T, int FRAC>
+void FmFixedReceiver<T, FRAC>::reset()
+{
+    for ( int j = 0; j < MAX_TAPS; j++ )
+    {
+        fir_cmplx_x_real[j] = fir_cmplx_x_imag[j] = 0;
+        fir_lpr_x[j] = fir_lmr_x[j] = fir_bp_x[j] = fir_pilot_x[j] = fir_hp_x[j] = 0;
+        deemph_l_x[j] = deemph_l_y[j] = deemph_r_x[j] = deemph_r_y[j] = 0;
+    }
+    demod_real = demod_imag = 0;
+}
+
+template <typename T, int FRAC>
+int FmFixedReceiver<T, FRAC>::process( const unsigned char *iq, size_t n, audio_t *left, audio_t *right )
+{
+    size_t done = 0;
+
+    n -= n % AUDIO_DECIM;
+    while ( done < n )
+    {
+        const int count = (n - done < (size_t)block) ? (int)(n - done) : block;
+        process_block( &iq[done * 4], count, &left[done / AUDIO_DECIM], &right[done / AUDIO_DECIM] );
+        done += count;
+    }
+    return (int)(n / AUDIO_DECIM);
+}
+
+template <typename T, int FRAC>
+void FmFixedReceiver<T, FRAC>::process_block( const unsigned char *iq, int n, audio_t *left, audio_t *right )
+{
+    const int n_audio = n / AUDIO_DECIM;
+    int i = 0;
+
+    fixed_read_IQ<T, FRAC>( iq, n, shift, I, Q );
+
+    // channel low-pass, demodulate
+    for ( i = 0; i < n; i++ )
+    {
+        fixed_fir_cmplx<T, FRAC>( &I[i], &Q[i], CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, fir_cmplx_x_real, fir_cmplx_x_imag,
+                                  CHANNEL_COEFF_TAPS, 1, &I_fir[i], &Q_fir[i] );
+        fixed_demodulate<T, FRAC>( I_fir[i], Q_fir[i], &demod_real, &demod_imag, FM_DEMOD_GAIN, &demod[i] );
+    }
+
+    // L+R low-pass, 256 kHz to 32 kHz
+    for ( i = 0; i < n_audio; i++ )
+    {
+        fixed_fir<T, FRAC>( &demod[i*AUDIO_DECIM], AUDIO_LPR_COEFFS, fir_lpr_x, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM, &lpr[i] );
+    }
+
+    // L-R band-pass; pilot band-pass, squared to 38 kHz, high-pass
+    for ( i = 0; i < n; i++ )
+    {
+        fixed_fir<T, FRAC>( &demod[i], BP_LMR_COEFFS, fir_bp_x, BP_LMR_COEFF_TAPS, 1, &bp_lmr[i] );
+        fixed_fir<T, FRAC>( &demod[i], BP_PILOT_COEFFS, fir_pilot_x, BP_PILOT_COEFF_TAPS, 1, &bp_pilot[i] );
+    }
+    fixed_multiply_n<T, FRAC>( bp_pilot, bp_pilot, n, square );
+    for ( i = 0; i < n; i++ )
+    {
+        fixed_fir<T, FRAC>( &square[i], HP_COEFFS, fir_hp_x, HP_COEFF_TAPS, 1, &carrier[i] );
+    }
+
+    // L-R to baseband, low-pass to 32 kHz
+    fixed_multiply_n<T, FRAC>( carrier, bp_lmr, n, mix );
+    for ( i = 0; i < n_audio; i++ )
+    {
+        fixed_fir<T, FRAC>( &mix[i*AUDIO_DECIM], AUDIO_LMR_COEFFS, fir_lmr_x, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM, &lmr[i] );
+    }
+
+    // 2L = (L+R) + (L-R), 2R = (L+R) - (L-R), deemphasis, volume
+    for ( i = 0; i < n_audio; i++ )
+    {
+        left_raw[i]  = fixed_traits<T>::store( (audio_t)lpr[i] + lmr[i] );
+        right_raw[i] = fixed_traits<T>::store( (audio_t)lpr[i] - lmr[i] );
+        fixed_iir<T, FRAC>( &left_raw[i], IIR_X_COEFFS, IIR_Y_COEFFS, deemph_l_x, deemph_l_y, IIR_COEFF_TAPS, 1, &left_deemph[i] );
+        fixed_iir<T, FRAC>( &right_raw[i], IIR_X_COEFFS, IIR_Y_COEFFS, deemph_r_x, deemph_r_y, IIR_COEFF_TAPS, 1, &right_deemph[i] );
+    }
+    fixed_gain_n<T, FRAC>( left_deemph, n_audio, VOLUME_LEVEL, left );
+    fixed_gain_n<T, FRAC>( right_deemph, n_audio, VOLUME_LEVEL, right );
+}
+
+#endif
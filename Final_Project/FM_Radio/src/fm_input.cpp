@@ -0,0 +1,129 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fm_input.h"
+
+
+int fm_input_open( fm_input *in, const char *path )
+{
+    struct stat st;
+
+    memset( in, 0, sizeof(*in) );
+    in->fd = (strcmp(path, "-") == 0) ? 0 : open( path, O_RDONLY );
+    if ( in->fd < 0 )
+    {
+        printf( "Unable to open %s\n", path );
+        return -1;
+    }
+
+    if ( fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 )
+    {
+        void *p = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0 );
+        if ( p != MAP_FAILED )
+        {
+            in->map  = (const uint8_t *)p;
+            in->size = (size_t)st.st_size;
+            madvise( p, in->size, MADV_SEQUENTIAL );
+        }
+    }
+
+    return 0;
+}
+
+void fm_input_close( fm_input *in )
+{
+    if ( in->map != NULL )
+    {
+        munmap( (void *)in->map, in->size );
+    }
+    if ( in->fd > 0 )
+    {
+        close( in->fd );
+    }
+    free( in->buf[0] );
+    free( in->buf[1] );
+    memset( in, 0, sizeof(*in) );
+    in->fd = -1;
+}
+
+long fm_input_samples( const fm_input *in )
+{
+    return (in->map != NULL) ? (long)(in->size / 4) : -1;
+}
+
+static int input_read( fm_input *in, int max_samples, const uint8_t **iq )
+{
+    const size_t want = (size_t)max_samples * 4;
+    const int k = in->buf_next;
+    size_t got = 0;
+
+    if ( in->buf_size[k] < want )
+    {
+        free( in->buf[k] );
+        in->buf[k] = (uint8_t *)malloc( want );
+        in->buf_size[k] = (in->buf[k] != NULL) ? want : 0;
+        if ( in->buf[k] == NULL ) return 0;
+    }
+
+    // pipes return short reads; fill the block unless the stream ends
+    while ( got < want )
+    {
+        ssize_t r = read( in->fd, &in->buf[k][got], want - got );
+        if ( r <= 0 ) break;
+        got += (size_t)r;
+    }
+
+    // the previous block stays in the other buffer
+    in->buf_next = 1 - k;
+    *iq = in->buf[k];
+    return (int)(got / 4);
+}
+
+int fm_input_next( fm_input *in, int max_samples, const uint8_t **iq )
+{
+    if ( in->map == NULL )
+    {
+        return input_read( in, max_samples, iq );
+    }
+
+    const long page = sysconf( _SC_PAGESIZE );
+    const size_t left = (in->size - in->pos) / 4;
+    const int n = (left < (size_t)max_samples) ? (int)left : max_samples;
+
+    // the block before the previous one is no longer referenced; release
+    // what lies before it once a window's worth has piled up
+    const size_t drop = in->prev & ~(size_t)(page - 1);
+    if ( drop >= in->dropped + FM_INPUT_READAHEAD )
+    {
+        madvise( (void *)&in->map[in->dropped], drop - in->dropped, MADV_DONTNEED );
+        in->dropped = drop;
+    }
+
+    // once this block reaches the last prefetched window, start reading
+    // the window after it
+    const size_t end = in->pos + (size_t)n * 4;
+    if ( end >= in->ahead_from && in->ahead_to < in->size )
+    {
+        const size_t end_page = end & ~(size_t)(page - 1);
+        const size_t from = (in->ahead_to > end_page) ? in->ahead_to : end_page;
+        if ( from < in->size )
+        {
+            size_t len = in->size - from;
+            if ( len > FM_INPUT_READAHEAD ) len = FM_INPUT_READAHEAD;
+            madvise( (void *)&in->map[from], len, MADV_WILLNEED );
+            in->ahead_from = from;
+            in->ahead_to = from + len;
+        }
+    }
+
+    *iq = &in->map[in->pos];
+    in->prev = in->pos;
+    in->pos += (size_t)n * 4;
+    return n;
+}
@@ -0,0 +1,54 @@
+#ifndef __FM_INPUT_H__
+#define __FM_INPUT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Zero-copy I/Q input.
+//
+// A capture file is mmap'ed read-only with MADV_SEQUENTIAL and
+// handed out block by block as pointers into the mapping, so
+// read_IQ() unpacks straight from the page cache: no fread()
+// copy and no syscall per block. Ahead of the current block
+// the file is prefetched with MADV_WILLNEED one readahead
+// window at a time, and pages more than two blocks behind are
+// dropped in window-sized batches, which keeps the resident
+// set small on multi-gigabyte captures at a couple of
+// syscalls per window rather than per block. Inputs that cannot be mapped (pipes,
+// stdin as "-") fall back to read() into two internal buffers
+// used in turn, so a block outlives the next call either way.
+// -------------------------------------------------------
+
+#define FM_INPUT_READAHEAD  (4 << 20)   // bytes per prefetch window and per drop batch
+
+struct fm_input
+{
+    int fd;
+    const uint8_t *map;     // whole file, NULL when streaming
+    size_t size;            // bytes in the mapping
+    size_t pos;             // next byte to hand out
+    size_t prev;            // start of the previous block
+    size_t dropped;         // [0, dropped) is released
+    size_t ahead_from;      // last prefetch window [ahead_from, ahead_to)
+    size_t ahead_to;
+    uint8_t *buf[2];        // read() fallback buffers, used in turn
+    size_t buf_size[2];
+    int buf_next;           // buffer the next read() block goes to
+};
+
+// returns 0 on success, -1 (with a message) when the file cannot be opened
+int fm_input_open( fm_input *in, const char *path );
+
+void fm_input_close( fm_input *in );
+
+// Points *iq at the next block of up to max_samples I/Q pairs (4 bytes each)
+// and returns the number of whole pairs in it. The last block of a capture
+// is shorter; a trailing partial pair is dropped. Returns 0 at the end.
+// The block stays valid until the call after next.
+int fm_input_next( fm_input *in, int max_samples, const uint8_t **iq );
+
+// total I/Q pairs in a mapped input, -1 when streaming
+long fm_input_samples( const fm_input *in );
+
+#endif
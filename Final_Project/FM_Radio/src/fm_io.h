@@ -0,0 +1,46 @@
+#ifndef __FM_IO_H__
+#define __FM_IO_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// -------------------------------------------------------
+// Helpers shared by the file writers (audio outputs, golden
+// dumps): a write() loop that rides out short writes, and
+// the little-endian fields of their file headers.
+// -------------------------------------------------------
+
+// returns 0, or -1 when a write failed
+static inline int fm_write_all( int fd, const void *data, size_t bytes )
+{
+    const char *p = (const char *)data;
+    while ( bytes > 0 )
+    {
+        ssize_t r = write( fd, p, bytes );
+        if ( r <= 0 ) return -1;
+        p += r;
+        bytes -= (size_t)r;
+    }
+    return 0;
+}
+
+static inline void fm_put_le( unsigned char *p, uint64_t v, int bytes )
+{
+    for ( int i = 0; i < bytes; i++ )
+    {
+        p[i] = (unsigned char)(v >> (8*i));
+    }
+}
+
+static inline uint64_t fm_get_le( const unsigned char *p, int bytes )
+{
+    uint64_t v = 0;
+    for ( int i = 0; i < bytes; i++ )
+    {
+        v |= (uint64_t)p[i] << (8*i);
+    }
+    return v;
+}
+
+#endif
@@ -0,0 +1,359 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fm_output.h"
+#include "fm_io.h"
+
+#define WAV_HEADER  44
+
+
+// RIFF / fmt / data header for 16-bit stereo PCM with data_bytes of audio
+static void wav_header( unsigned char *h, int rate, unsigned int data_bytes )
+{
+    memcpy( &h[0], "RIFF", 4 );
+    fm_put_le( &h[4], data_bytes + WAV_HEADER - 8, 4 );
+    memcpy( &h[8], "WAVEfmt ", 8 );
+    fm_put_le( &h[16], 16, 4 );         // fmt chunk size
+    fm_put_le( &h[20], 1, 2 );          // PCM
+    fm_put_le( &h[22], 2, 2 );          // channels
+    fm_put_le( &h[24], rate, 4 );
+    fm_put_le( &h[28], rate * 4, 4 );   // byte rate
+    fm_put_le( &h[32], 4, 2 );          // block align
+    fm_put_le( &h[34], 16, 2 );         // bits per sample
+    memcpy( &h[36], "data", 4 );
+    fm_put_le( &h[40], data_bytes, 4 );
+}
+
+static short saturate( int x )
+{
+    return (short)((x > 32767) ? 32767 : (x < -32768) ? -32768 : x);
+}
+
+
+int fm_output_open( fm_output *o, fm_output_kind kind, const char *path, int rate )
+{
+    memset( o, 0, sizeof(*o) );
+    o->kind = kind;
+    o->rate = rate;
+    o->fd   = -1;
+
+    if ( kind == FM_OUT_NULL )
+    {
+        return 0;
+    }
+
+    o->fd = (strcmp(path, "-") == 0) ? 1 : open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( o->fd < 0 )
+    {
+        fprintf( stderr, "Unable to open %s\n", path );
+        return -1;
+    }
+
+    if ( kind == FM_OUT_WAV )
+    {
+        // streaming readers take the maximum size as "until EOF"
+        unsigned char h[WAV_HEADER];
+        wav_header( h, rate, 0xFFFFFFFFu - WAV_HEADER );
+        if ( fm_write_all( o->fd, h, WAV_HEADER ) < 0 )
+        {
+            fprintf( stderr, "Failed to write %s\n", path );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void fm_output_attach( fm_output *o, int fd, int rate )
+{
+    memset( o, 0, sizeof(*o) );
+    o->kind = FM_OUT_RAW;
+    o->rate = rate;
+    o->fd   = fd;
+    o->realtime = 1;
+}
+
+int fm_output_write_s16( fm_output *o, const short *frames, int n )
+{
+    o->samples += n;
+
+    if ( o->kind == FM_OUT_NULL || n <= 0 )
+    {
+        return 0;
+    }
+
+    if ( fm_write_all( o->fd, frames, (size_t)n * 2 * sizeof(short) ) < 0 )
+    {
+        fprintf( stderr, "Failed to write audio output!\n" );
+        return -1;
+    }
+
+    return 0;
+}
+
+int fm_output_write( fm_output *o, const int *left, const int *right, int n )
+{
+    o->samples += n;
+
+    if ( o->kind == FM_OUT_NULL || n <= 0 )
+    {
+        return 0;
+    }
+
+    if ( o->buf_samples < n )
+    {
+        delete [] o->buf;
+        o->buf = new short[2 * n];
+        o->buf_samples = n;
+    }
+
+    for ( int i = 0; i < n; i++ )
+    {
+        o->buf[2*i+0] = saturate( left[i] );
+        o->buf[2*i+1] = saturate( right[i] );
+    }
+
+    o->samples -= n;
+    return fm_output_write_s16( o, o->buf, n );
+}
+
+void fm_output_close( fm_output *o )
+{
+    if ( o->kind == FM_OUT_WAV && o->fd >= 0 && lseek( o->fd, 0, SEEK_SET ) == 0 )
+    {
+        unsigned char h[WAV_HEADER];
+        wav_header( h, o->rate, (unsigned int)(o->samples * 4) );
+        fm_write_all( o->fd, h, WAV_HEADER );
+    }
+
+    if ( o->fd > 1 )
+    {
+        close( o->fd );
+    }
+
+    delete [] o->buf;
+    o->buf = NULL;
+    o->buf_samples = 0;
+    o->fd = -1;
+}
+
+double fm_output_seconds( const fm_output *o )
+{
+    return (double)o->samples / o->rate;
+}
+
+
+// -------------------------------------------------------
+// FmAudioWriter
+// -------------------------------------------------------
+
+FmAudioWriter::FmAudioWriter( fm_output *out, int drop, int slots, int slot_frames )
+{
+    this->out         = out;
+    this->drop        = drop;
+    this->slots       = (slots < 2) ? 2 : slots;
+    this->slot_frames = (slot_frames < 1) ? 1 : slot_frames;
+
+    buf  = new short[(size_t)(this->slots + 1) * this->slot_frames * 2];
+    fill = new int[this->slots];
+    head = 0;
+    tail = 0;
+    cur  = 0;
+    quit = 0;
+    discard = 0;
+
+    n_overrun  = 0;
+    n_underrun = 0;
+    n_dropped  = 0;
+    n_errors   = 0;
+
+    pthread_mutex_init( &lock, NULL );
+    pthread_cond_init( &data, NULL );
+    pthread_cond_init( &space, NULL );
+
+    running = (pthread_create( &thread, NULL, writer_main, this ) == 0);
+    if ( !running )
+    {
+        fprintf( stderr, "FmAudioWriter: cannot create the writer thread, writing synchronously\n" );
+    }
+}
+
+FmAudioWriter::~FmAudioWriter()
+{
+    flush();
+
+    if ( running )
+    {
+        pthread_mutex_lock( &lock );
+        quit = 1;
+        pthread_cond_signal( &data );
+        pthread_mutex_unlock( &lock );
+        pthread_join( thread, NULL );
+    }
+
+    pthread_cond_destroy( &space );
+    pthread_cond_destroy( &data );
+    pthread_mutex_destroy( &lock );
+    delete [] fill;
+    delete [] buf;
+}
+
+// makes sure slot head is free to pack into; returns 0 when the ring is full
+// and the block has to be dropped
+int FmAudioWriter::acquire()
+{
+    if ( cur > 0 )
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock( &lock );
+    if ( head - tail == slots )
+    {
+        n_overrun++;
+        while ( !drop && head - tail == slots )
+        {
+            pthread_cond_wait( &space, &lock );
+        }
+    }
+    const int ok = (head - tail < slots);
+    pthread_mutex_unlock( &lock );
+
+    return ok;
+}
+
+void FmAudioWriter::publish()
+{
+    if ( !running )
+    {
+        if ( fm_output_write_s16( out, &buf[0], cur ) < 0 ) n_errors++;
+        cur = 0;
+        return;
+    }
+
+    pthread_mutex_lock( &lock );
+    fill[head % slots] = cur;
+    head++;
+    pthread_cond_signal( &data );
+    pthread_mutex_unlock( &lock );
+    cur = 0;
+}
+
+void FmAudioWriter::write( const int *left, const int *right, int n )
+{
+    int i = 0;
+
+    while ( i < n )
+    {
+        if ( running && !acquire() )
+        {
+            n_dropped += n - i;
+            return;
+        }
+
+        // the decoder owns slot head until it is published
+        short *slot = &buf[(size_t)(running ? head % slots : 0) * slot_frames * 2];
+        const int count = (n - i < slot_frames - cur) ? n - i : slot_frames - cur;
+
+        for ( int j = 0; j < count; j++ )
+        {
+            slot[2*(cur+j)+0] = saturate( left[i+j] );
+            slot[2*(cur+j)+1] = saturate( right[i+j] );
+        }
+        cur += count;
+        i += count;
+
+        if ( cur == slot_frames )
+        {
+            publish();
+        }
+    }
+}
+
+short *FmAudioWriter::reserve( int *frames )
+{
+    discard = (running && !acquire());
+    if ( discard )
+    {
+        *frames = slot_frames;
+        return &buf[(size_t)slots * slot_frames * 2];
+    }
+
+    *frames = slot_frames - cur;
+    return &buf[((size_t)(running ? head % slots : 0) * slot_frames + cur) * 2];
+}
+
+void FmAudioWriter::commit( int frames )
+{
+    if ( discard )
+    {
+        n_dropped += frames;
+        discard = 0;
+        return;
+    }
+
+    cur += frames;
+    if ( cur == slot_frames )
+    {
+        publish();
+    }
+}
+
+void FmAudioWriter::flush()
+{
+    if ( cur > 0 )
+    {
+        publish();
+    }
+
+    if ( running )
+    {
+        pthread_mutex_lock( &lock );
+        while ( tail < head )
+        {
+            pthread_cond_wait( &space, &lock );
+        }
+        pthread_mutex_unlock( &lock );
+    }
+}
+
+void *FmAudioWriter::writer_main( void *arg )
+{
+    FmAudioWriter *w = (FmAudioWriter *)arg;
+
+    pthread_mutex_lock( &w->lock );
+    for ( ;; )
+    {
+        if ( w->tail == w->head )
+        {
+            if ( w->quit ) break;
+
+            // nothing to play: a real-time device ran dry unless the stream ended
+            const int started = (w->tail > 0) && w->out->realtime;
+            while ( w->tail == w->head && !w->quit )
+            {
+                pthread_cond_wait( &w->data, &w->lock );
+            }
+            if ( started && w->tail < w->head ) w->n_underrun++;
+            continue;
+        }
+
+        const int k = (int)(w->tail % w->slots);
+        const int n = w->fill[k];
+        pthread_mutex_unlock( &w->lock );
+
+        const int err = fm_output_write_s16( w->out, &w->buf[(size_t)k * w->slot_frames * 2], n );
+
+        pthread_mutex_lock( &w->lock );
+        if ( err < 0 ) w->n_errors++;
+        w->tail++;
+        pthread_cond_broadcast( &w->space );
+    }
+    pthread_mutex_unlock( &w->lock );
+
+    return NULL;
+}
@@ -0,0 +1,132 @@
+#ifndef __FM_OUTPUT_H__
+#define __FM_OUTPUT_H__
+
+#include <pthread.h>
+
+// -------------------------------------------------------
+// Audio outputs.
+//
+// Stand-ins for the OSS device for machines without one:
+//
+//   FM_OUT_WAV  - 16-bit stereo PCM .wav (header sizes are
+//                 patched on close when the file is seekable)
+//   FM_OUT_RAW  - raw interleaved s16 (native endian), e.g.
+//                 "-" to pipe into aplay / sox / ffmpeg
+//   FM_OUT_NULL - discards the audio, only counts samples
+//
+// or any descriptor that takes interleaved s16, such as the
+// OSS device from audio_init(). Samples are saturated to the
+// s16 range instead of wrapping. FmAudioWriter moves the
+// write() calls off the decoding thread.
+// -------------------------------------------------------
+
+enum fm_output_kind
+{
+    FM_OUT_WAV,
+    FM_OUT_RAW,
+    FM_OUT_NULL
+};
+
+struct fm_output
+{
+    fm_output_kind kind;
+    int fd;
+    int rate;
+    int realtime;       // plays as it is written (fm_output_attach)
+    long samples;       // per channel, written so far
+    short *buf;         // interleaving buffer, grown on demand
+    int buf_samples;
+};
+
+// path "-" is stdout; ignored for FM_OUT_NULL. Returns 0, or -1 with a
+// message on stderr.
+int fm_output_open( fm_output *o, fm_output_kind kind, const char *path, int rate );
+
+// raw output to an open descriptor that plays in real time, such as the
+// OSS device (closed by fm_output_close())
+void fm_output_attach( fm_output *o, int fd, int rate );
+
+// returns 0, or -1 when the write failed
+int fm_output_write( fm_output *o, const int *left, const int *right, int n );
+
+// n frames of interleaved s16 (left, right)
+int fm_output_write_s16( fm_output *o, const short *frames, int n );
+
+void fm_output_close( fm_output *o );
+
+// seconds of audio written so far
+double fm_output_seconds( const fm_output *o );
+
+
+
+#define FM_WRITER_SLOTS     8
+#define FM_WRITER_FRAMES    (32000 / 50)    // 20 ms at AUDIO_RATE per slot
+
+// Asynchronous writer: the decoder packs saturated interleaved s16 into a
+// preallocated ring of slots and a dedicated thread drains full slots into
+// an fm_output, so the decoding thread never waits on write().
+//
+// When the ring is full the decoder either drops the block (drop = 1, for
+// live input that cannot be slowed down) or waits for a free slot (drop = 0,
+// for file input, where pausing the decoder loses nothing). Either way it
+// counts an overrun. For a real-time output (fm_output_attach()) the
+// writer counts an underrun each time it finds the ring empty after the
+// first slot, i.e. when the device may have starved; files and the null
+// output cannot starve, so none are counted for them.
+class FmAudioWriter
+{
+public:
+    FmAudioWriter( fm_output *out, int drop = 0, int slots = FM_WRITER_SLOTS, int slot_frames = FM_WRITER_FRAMES );
+    ~FmAudioWriter();
+
+    void write( const int *left, const int *right, int n );
+
+    // Zero-copy variant: returns where the next frames of interleaved s16 go
+    // and in *frames how many fit there (at least 1). The caller fills up to
+    // that many and hands them over with commit(). In drop mode a full ring
+    // yields a scratch area whose frames are counted as dropped.
+    short *reserve( int *frames );
+    void commit( int frames );
+
+    // hand over the partly filled slot and wait until the ring is drained
+    void flush();
+
+    long overruns() const { return n_overrun; }
+    long underruns() const { return n_underrun; }
+    long dropped() const { return n_dropped; }     // frames lost with drop = 1
+    int write_errors() const { return n_errors; }
+
+private:
+    FmAudioWriter( const FmAudioWriter & );
+    FmAudioWriter & operator=( const FmAudioWriter & );
+
+    static void *writer_main( void *arg );
+    int acquire();
+    void publish();
+
+    fm_output *out;
+    int drop;
+    int slots;
+    int slot_frames;
+
+    short *buf;         // slots * slot_frames interleaved frames, plus a scratch slot
+    int discard;        // the reserved frames go to the scratch slot
+    int *fill;          // frames in each published slot
+    long head;          // slots published by the decoder
+    long tail;          // slots written out
+    int cur;            // frames packed into slot head, not yet published
+    int quit;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  data;
+    pthread_cond_t  space;
+    pthread_t thread;
+    int running;
+
+    long n_overrun;
+    long n_underrun;
+    long n_dropped;
+    int n_errors;
+};
+
+#endif
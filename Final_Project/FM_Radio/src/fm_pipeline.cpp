@@ -0,0 +1,516 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "fm_pipeline.h"
+#include "fm_prof.h"
+
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// short spin for the common case of a stage that is just ahead, then give
+// the CPU away so oversubscribed hosts still make progress
+static void queue_wait( int *spins )
+{
+    if ( ++(*spins) < 64 )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    else
+    {
+        sched_yield();
+    }
+}
+
+
+// -------------------------------------------------------
+// FmSpscQueue
+// -------------------------------------------------------
+
+FmSpscQueue::FmSpscQueue( int slots, int slot_ints )
+{
+    this->slots     = slots;
+    this->slot_ints = slot_ints;
+    buf   = new int[(size_t)slots * slot_ints];
+    count = new int[slots];
+    head.store( 0 );
+    tail.store( 0 );
+    n_full  = 0;
+    n_empty = 0;
+}
+
+FmSpscQueue::~FmSpscQueue()
+{
+    delete [] count;
+    delete [] buf;
+}
+
+int *FmSpscQueue::write_slot()
+{
+    const unsigned h = head.load( std::memory_order_relaxed );
+    int spins = 0;
+
+    if ( h - tail.load( std::memory_order_acquire ) == (unsigned)slots )
+    {
+        n_full++;
+        while ( h - tail.load( std::memory_order_acquire ) == (unsigned)slots )
+        {
+            queue_wait( &spins );
+        }
+    }
+
+    return &buf[(size_t)(h % slots) * slot_ints];
+}
+
+void FmSpscQueue::push( int n )
+{
+    const unsigned h = head.load( std::memory_order_relaxed );
+
+    count[h % slots] = n;
+    head.store( h + 1, std::memory_order_release );
+}
+
+const int *FmSpscQueue::read_slot( int *n )
+{
+    const unsigned t = tail.load( std::memory_order_relaxed );
+    int spins = 0;
+
+    if ( head.load( std::memory_order_acquire ) == t )
+    {
+        n_empty++;
+        while ( head.load( std::memory_order_acquire ) == t )
+        {
+            queue_wait( &spins );
+        }
+    }
+
+    *n = count[t % slots];
+    return &buf[(size_t)(t % slots) * slot_ints];
+}
+
+void FmSpscQueue::pop()
+{
+    tail.store( tail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+void FmSpscQueue::clear()
+{
+    tail.store( head.load() );
+}
+
+
+// -------------------------------------------------------
+// FmPipeline
+// -------------------------------------------------------
+
+FmPipeline::FmPipeline( int block_samples, int depth )
+{
+    block = block_samples - (block_samples % AUDIO_DECIM);
+    if ( block < AUDIO_DECIM )
+    {
+        block = AUDIO_DECIM;
+    }
+    this->depth = (depth < 2) ? 2 : depth;
+
+    const int audio_block = block / AUDIO_DECIM;
+    queue[Q_CH]       = new FmSpscQueue( this->depth, 2 * block );  // I_fir | Q_fir
+    queue[Q_LPR_IN]   = new FmSpscQueue( this->depth, block );
+    queue[Q_BP_IN]    = new FmSpscQueue( this->depth, block );
+    queue[Q_PILOT_IN] = new FmSpscQueue( this->depth, block );
+    queue[Q_LPR]      = new FmSpscQueue( this->depth, audio_block );
+    queue[Q_BP]       = new FmSpscQueue( this->depth, block );
+    queue[Q_PILOT]    = new FmSpscQueue( this->depth, block );
+
+    pinning = (sysconf(_SC_NPROCESSORS_ONLN) >= FM_PIPE_STAGES);
+    source = NULL;
+    source_arg = NULL;
+    sink = NULL;
+    sink_arg = NULL;
+    delivered = 0;
+    memset( busy, 0, sizeof(busy) );
+
+    fir_cmplx_setup( &fir_channel, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, CHANNEL_COEFF_TAPS, 1 );
+    fir_setup( &fir_lpr, AUDIO_LPR_COEFFS, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM );
+    fir_setup( &fir_lmr, AUDIO_LMR_COEFFS, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM );
+    fir_setup( &fir_bp, BP_LMR_COEFFS, BP_LMR_COEFF_TAPS, 1 );
+    fir_setup( &fir_pilot, BP_PILOT_COEFFS, BP_PILOT_COEFF_TAPS, 1 );
+    fir_setup( &fir_hp, HP_COEFFS, HP_COEFF_TAPS, 1 );
+    reset();
+}
+
+FmPipeline::~FmPipeline()
+{
+    for ( int k = 0; k < N_QUEUES; k++ )
+    {
+        delete queue[k];
+    }
+}
+
+void FmPipeline::reset()
+{
+    fir_cmplx_reset( &fir_channel );
+    demod_real[0] = 0;
+    demod_imag[0] = 0;
+    fir_reset( &fir_lpr );
+    fir_reset( &fir_lmr );
+    fir_reset( &fir_bp );
+    fir_reset( &fir_pilot );
+    fir_reset( &fir_hp );
+    memset( deemph_l_x, 0, sizeof(deemph_l_x) );
+    memset( deemph_l_y, 0, sizeof(deemph_l_y) );
+    memset( deemph_r_x, 0, sizeof(deemph_r_x) );
+    memset( deemph_r_y, 0, sizeof(deemph_r_y) );
+}
+
+const char *FmPipeline::stage_name( int stage )
+{
+    static const char *names[FM_PIPE_STAGES] = { "front", "demod", "lpr", "bp", "pilot", "output" };
+    return (stage >= 0 && stage < FM_PIPE_STAGES) ? names[stage] : "?";
+}
+
+long FmPipeline::full_waits() const
+{
+    long n = 0;
+    for ( int k = 0; k < N_QUEUES; k++ )
+    {
+        n += queue[k]->full_waits();
+    }
+    return n;
+}
+
+long FmPipeline::run( fm_source source, void *source_arg, fm_sink sink, void *sink_arg )
+{
+    pthread_t threads[FM_PIPE_STAGES];
+    int started = 0;
+
+    this->source     = source;
+    this->source_arg = source_arg;
+    this->sink       = sink;
+    this->sink_arg   = sink_arg;
+    delivered = 0;
+    memset( busy, 0, sizeof(busy) );
+
+    // consumers first: when a stage cannot be created, only stages
+    // downstream of it are running and they can be ended cleanly
+    for ( int k = FM_PIPE_STAGES - 1; k >= 0; k-- )
+    {
+        args[k].pipe  = this;
+        args[k].stage = k;
+        if ( pthread_create( &threads[k], NULL, stage_main, &args[k] ) != 0 )
+        {
+            break;
+        }
+        started++;
+    }
+
+    const int missing = FM_PIPE_STAGES - started;   // stages 0 .. missing-1
+
+    if ( missing > 0 )
+    {
+        fprintf( stderr, "FmPipeline: cannot create stage %d, decoding serially\n", missing - 1 );
+
+        // end of stream on every queue a missing stage would have fed
+        for ( int k = 0; k < missing; k++ )
+        {
+            end_outputs( k );
+        }
+    }
+
+    for ( int k = missing; k < FM_PIPE_STAGES; k++ )
+    {
+        pthread_join( threads[k], NULL );
+    }
+
+    if ( missing > 0 )
+    {
+        // end markers nobody consumed must not end the next run
+        for ( int q = 0; q < N_QUEUES; q++ )
+        {
+            queue[q]->clear();
+        }
+        run_serial();
+    }
+
+    return delivered;
+}
+
+// pushes the end-of-stream marker into the output queues of a stage
+void FmPipeline::end_outputs( int stage )
+{
+    static const int outputs[FM_PIPE_STAGES][4] =
+    {
+        { Q_CH, -1 },
+        { Q_LPR_IN, Q_BP_IN, Q_PILOT_IN, -1 },
+        { Q_LPR, -1 },
+        { Q_BP, -1 },
+        { Q_PILOT, -1 },
+        { -1 }
+    };
+
+    for ( int j = 0; outputs[stage][j] >= 0; j++ )
+    {
+        queue[outputs[stage][j]]->write_slot();
+        queue[outputs[stage][j]]->push( 0 );
+    }
+}
+
+// the whole stream through one FmReceiver on the calling thread, with the
+// source / sink contract of run(); filter state starts from zero
+void FmPipeline::run_serial()
+{
+    FmReceiver rx( block );
+    uint8_t *iq = new uint8_t[(size_t)block * 4];
+    int *left = new int[block / AUDIO_DECIM];
+    int *right = new int[block / AUDIO_DECIM];
+    int got = 0;
+
+    while ( (got = source( source_arg, iq, block )) > 0 )
+    {
+        const int n_audio = rx.process( iq, got, left, right );
+        if ( n_audio > 0 )
+        {
+            sink( sink_arg, left, right, n_audio );
+            delivered += n_audio;
+        }
+    }
+
+    delete [] right;
+    delete [] left;
+    delete [] iq;
+}
+
+void *FmPipeline::stage_main( void *arg )
+{
+    stage_arg *a = (stage_arg *)arg;
+    FmPipeline *p = a->pipe;
+
+#ifdef __linux__
+    if ( p->pinning )
+    {
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        CPU_SET( a->stage % sysconf(_SC_NPROCESSORS_ONLN), &set );
+        pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+    }
+#endif
+
+    switch ( a->stage )
+    {
+        case 0: p->stage_front();  break;
+        case 1: p->stage_demod();  break;
+        case 2: p->stage_lpr();    break;
+        case 3: p->stage_bp();     break;
+        case 4: p->stage_pilot();  break;
+        default: p->stage_output(); break;
+    }
+
+    return NULL;
+}
+
+
+void FmPipeline::stage_front()
+{
+    uint8_t *iq = new uint8_t[(size_t)block * 4];
+    int *I_buf = new int[FIR_PREFIX + block];
+    int *Q_buf = new int[FIR_PREFIX + block];
+    int *I = &I_buf[FIR_PREFIX];
+    int *Q = &Q_buf[FIR_PREFIX];
+    FmSpscQueue *out = queue[Q_CH];
+    int got = 0;
+
+    do
+    {
+        got = source( source_arg, iq, block );
+        const int n = (got > 0) ? got - (got % AUDIO_DECIM) : 0;
+
+        // a short read without a whole AUDIO_DECIM group does not end the stream
+        if ( n == 0 && got > 0 ) continue;
+
+        int *slot = out->write_slot();
+        const double t0 = now_sec();
+
+        if ( n > 0 )
+        {
+            FM_PROF( FM_ST_READ_IQ, n, read_IQ( iq, I, Q, n ) );
+            FM_PROF( FM_ST_CHANNEL, n, fir_cmplx_filter_prefixed( &fir_channel, I, Q, n, slot, &slot[block] ) );
+        }
+
+        busy[0] += now_sec() - t0;
+        out->push( n );
+    }
+    while ( got > 0 );
+
+    delete [] Q_buf;
+    delete [] I_buf;
+    delete [] iq;
+}
+
+void FmPipeline::stage_demod()
+{
+    FmSpscQueue *in = queue[Q_CH];
+    int n = 0;
+
+    do
+    {
+        const int *ch = in->read_slot( &n );
+        int *lpr = queue[Q_LPR_IN]->write_slot();
+        int *bp = queue[Q_BP_IN]->write_slot();
+        int *pilot = queue[Q_PILOT_IN]->write_slot();
+        const double t0 = now_sec();
+
+        if ( n > 0 )
+        {
+            FM_PROF( FM_ST_DEMOD, n, demodulate_n( (int *)ch, (int *)&ch[block], demod_real, demod_imag, n, FM_DEMOD_GAIN, lpr ) );
+            memcpy( bp, lpr, n * sizeof(int) );
+            memcpy( pilot, lpr, n * sizeof(int) );
+        }
+
+        busy[1] += now_sec() - t0;
+        in->pop();
+        queue[Q_LPR_IN]->push( n );
+        queue[Q_BP_IN]->push( n );
+        queue[Q_PILOT_IN]->push( n );
+    }
+    while ( n > 0 );
+}
+
+// L+R low-pass FIR filter - reduce sampling rate from 256 KHz to 32 KHz
+void FmPipeline::stage_lpr()
+{
+    FmSpscQueue *in = queue[Q_LPR_IN];
+    FmSpscQueue *out = queue[Q_LPR];
+    int n = 0;
+
+    do
+    {
+        const int *demod = in->read_slot( &n );
+        int *slot = out->write_slot();
+        const double t0 = now_sec();
+
+        if ( n > 0 )
+        {
+            FM_PROF( FM_ST_LPR, n, fir_filter_n( &fir_lpr, (int *)demod, n, slot ) );
+        }
+
+        busy[2] += now_sec() - t0;
+        in->pop();
+        out->push( n );
+    }
+    while ( n > 0 );
+}
+
+// L-R band-pass filter extracts the L-R channel from 23kHz to 53kHz
+void FmPipeline::stage_bp()
+{
+    FmSpscQueue *in = queue[Q_BP_IN];
+    FmSpscQueue *out = queue[Q_BP];
+    int n = 0;
+
+    do
+    {
+        const int *demod = in->read_slot( &n );
+        int *slot = out->write_slot();
+        const double t0 = now_sec();
+
+        if ( n > 0 )
+        {
+            FM_PROF( FM_ST_BP_LMR, n, fir_filter_n( &fir_bp, (int *)demod, n, slot ) );
+        }
+
+        busy[3] += now_sec() - t0;
+        in->pop();
+        out->push( n );
+    }
+    while ( n > 0 );
+}
+
+// pilot band-pass, square to 38kHz, high-pass to remove the 0Hz tone
+void FmPipeline::stage_pilot()
+{
+    FmSpscQueue *in = queue[Q_PILOT_IN];
+    FmSpscQueue *out = queue[Q_PILOT];
+    int *bp_pilot = new int[block];
+    int n = 0;
+
+    do
+    {
+        const int *demod = in->read_slot( &n );
+        int *slot = out->write_slot();
+        const double t0 = now_sec();
+
+        if ( n > 0 )
+        {
+            FM_PROF( FM_ST_BP_PILOT, n, fir_filter_n( &fir_pilot, (int *)demod, n, bp_pilot ) );
+            FM_PROF( FM_ST_SQUARE, n, multiply_n( bp_pilot, bp_pilot, n, bp_pilot ) );
+            FM_PROF( FM_ST_HP, n, fir_filter_n( &fir_hp, bp_pilot, n, slot ) );
+        }
+
+        busy[4] += now_sec() - t0;
+        in->pop();
+        out->push( n );
+    }
+    while ( n > 0 );
+
+    delete [] bp_pilot;
+}
+
+void FmPipeline::stage_output()
+{
+    const int audio_block = block / AUDIO_DECIM;
+    int *multiply = new int[block];
+    int *audio = new int[3 * audio_block];
+    int *audio_lmr    = audio;
+    int *left         = &audio[1 * audio_block];
+    int *right        = &audio[2 * audio_block];
+    int n = 0;
+    int n_bp = 0;
+    int n_pilot = 0;
+
+    do
+    {
+        const int *audio_lpr = queue[Q_LPR]->read_slot( &n );
+        const int *bp = queue[Q_BP]->read_slot( &n_bp );
+        const int *carrier = queue[Q_PILOT]->read_slot( &n_pilot );
+        const int n_audio = n / AUDIO_DECIM;
+        const double t0 = now_sec();
+
+        if ( n > 0 )
+        {
+            // demodulate the L-R channel from 38kHz to baseband
+            FM_PROF( FM_ST_MIX, n, multiply_n( (int *)carrier, (int *)bp, n, multiply ) );
+
+            // L-R low-pass FIR filter - reduce sampling rate from 256 KHz to 32 KHz
+            FM_PROF( FM_ST_LMR, n, fir_filter_n( &fir_lmr, multiply, n, audio_lmr ) );
+
+            // add / sub -> deemphasis -> gain, both channels in one pass
+            FM_PROF( FM_ST_STEREO_OUT, n_audio,
+                     stereo_out_n( audio_lpr, audio_lmr, n_audio, deemph_l_x, deemph_l_y, deemph_r_x, deemph_r_y,
+                                   VOLUME_LEVEL, left, right, NULL ) );
+        }
+
+        queue[Q_LPR]->pop();
+        queue[Q_BP]->pop();
+        queue[Q_PILOT]->pop();
+        busy[5] += now_sec() - t0;
+
+        if ( n > 0 )
+        {
+            sink( sink_arg, left, right, n_audio );
+            delivered += n_audio;
+        }
+    }
+    while ( n > 0 );
+
+    delete [] audio;
+    delete [] multiply;
+}
@@ -0,0 +1,162 @@
+#ifndef __FM_PIPELINE_H__
+#define __FM_PIPELINE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <pthread.h>
+
+#include "fm_radio.h"
+
+// -------------------------------------------------------
+// Stage-pipelined stereo receiver.
+//
+// Every stage of the graph runs on its own thread and hands
+// fixed-size blocks to the next one through lock-free
+// single-producer / single-consumer ring queues:
+//
+//   front  : source -> read_IQ -> channel filter
+//   demod  : demodulate_n, fanned out to the three branches
+//   lpr    : AUDIO_LPR                        (32 kHz)
+//   bp     : BP_LMR
+//   pilot  : BP_PILOT -> square -> HP         (38 kHz carrier)
+//   output : L-R mix -> AUDIO_LMR -> stereo_out_n (add/sub, deemphasis, gain) -> sink
+//
+// Throughput is bounded by the slowest stage instead of the
+// sum of all of them. Filter state lives in the stages, so the
+// output is bit-exact with FmReceiver for any block size.
+// -------------------------------------------------------
+
+#define FM_PIPE_STAGES  6
+#define FM_PIPE_BLOCK   5120    // 640 audio samples, four 5 ms audio_tx() chunks
+#define FM_PIPE_DEPTH   8       // slots per queue
+
+// Fills iq with up to max_samples I/Q pairs (4 bytes each) and returns the
+// number of pairs written; 0 ends the stream.
+typedef int (*fm_source)( void *arg, uint8_t *iq, int max_samples );
+
+// Receives n samples of decoded left / right audio.
+typedef void (*fm_sink)( void *arg, const int *left, const int *right, int n );
+
+
+// Ring of preallocated blocks of slot_ints ints. The producer fills the slot
+// returned by write_slot() and publishes it with push(); the consumer reads
+// the oldest slot with read_slot() and returns it with pop(). Both sides
+// spin briefly and then yield while the ring is full / empty.
+class FmSpscQueue
+{
+public:
+    FmSpscQueue( int slots, int slot_ints );
+    ~FmSpscQueue();
+
+    int *write_slot();
+    void push( int n );                 // n = 0 marks the end of the stream
+
+    const int *read_slot( int *n );
+    void pop();
+
+    // drop every queued slot; only while neither side is running
+    void clear();
+
+    long full_waits() const { return n_full; }      // producer found the ring full
+    long empty_waits() const { return n_empty; }    // consumer found it empty
+
+private:
+    FmSpscQueue( const FmSpscQueue & );
+    FmSpscQueue & operator=( const FmSpscQueue & );
+
+    int *buf;
+    int *count;
+    int slots;
+    int slot_ints;
+
+    // producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<unsigned> head;
+    long n_full;
+    alignas(64) std::atomic<unsigned> tail;
+    long n_empty;
+};
+
+
+class FmPipeline
+{
+public:
+    FmPipeline( int block_samples = FM_PIPE_BLOCK, int depth = FM_PIPE_DEPTH );
+    ~FmPipeline();
+
+    // Streams the source through the graph until it returns 0 and hands every
+    // decoded block to the sink (called on the output thread, in order).
+    // Trailing samples of a block that do not fill a whole AUDIO_DECIM group
+    // are dropped. If a stage thread cannot be created, the stages already
+    // running are stopped and the stream is decoded serially by an
+    // FmReceiver on the calling thread instead.
+    // Returns the number of audio samples delivered per channel.
+    long run( fm_source source, void *source_arg, fm_sink sink, void *sink_arg );
+
+    // clear all filter and demodulator state
+    void reset();
+
+    // Pin stage k to CPU (k mod online CPUs). On by default when the host
+    // has at least FM_PIPE_STAGES CPUs.
+    void set_pinning( int enable ) { pinning = enable; }
+
+    int block_samples() const { return block; }
+
+    // seconds stage k spent working (not waiting) during the last run()
+    double stage_busy( int stage ) const { return busy[stage]; }
+    static const char *stage_name( int stage );
+
+    // producer stalls on a full queue, summed over all queues of the last run()
+    long full_waits() const;
+
+private:
+    FmPipeline( const FmPipeline & );
+    FmPipeline & operator=( const FmPipeline & );
+
+    enum { Q_CH, Q_LPR_IN, Q_BP_IN, Q_PILOT_IN, Q_LPR, Q_BP, Q_PILOT, N_QUEUES };
+
+    static void *stage_main( void *arg );
+    void end_outputs( int stage );
+    void run_serial();
+    void stage_front();
+    void stage_demod();
+    void stage_lpr();
+    void stage_bp();
+    void stage_pilot();
+    void stage_output();
+
+    int block;
+    int depth;
+    int pinning;
+
+    fm_source source;
+    void *source_arg;
+    fm_sink sink;
+    void *sink_arg;
+    long delivered;
+
+    FmSpscQueue *queue[N_QUEUES];
+    double busy[FM_PIPE_STAGES];
+
+    struct stage_arg
+    {
+        FmPipeline *pipe;
+        int stage;
+    };
+    stage_arg args[FM_PIPE_STAGES];
+
+    // filter and demodulator state, each owned by one stage
+    fir_cmplx_filter fir_channel;
+    int demod_real[1];
+    int demod_imag[1];
+    fir_filter fir_lpr;
+    fir_filter fir_lmr;
+    fir_filter fir_bp;
+    fir_filter fir_pilot;
+    fir_filter fir_hp;
+    int deemph_l_x[MAX_TAPS];
+    int deemph_l_y[MAX_TAPS];
+    int deemph_r_x[MAX_TAPS];
+    int deemph_r_y[MAX_TAPS];
+};
+
+#endif
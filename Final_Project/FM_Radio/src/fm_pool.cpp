@@ -0,0 +1,114 @@
+#include <stdio.h>
+
+#include "fm_pool.h"
+
+
+FmPool::FmPool( int workers )
+{
+    pthread_mutex_init( &lock, NULL );
+    pthread_cond_init( &start, NULL );
+    pthread_cond_init( &done, NULL );
+
+    n_tasks   = 0;
+    next_task = 0;
+    pending   = 0;
+    quit      = 0;
+    n_workers = 0;
+
+    if ( workers > FM_POOL_MAX_WORKERS ) workers = FM_POOL_MAX_WORKERS;
+
+    for ( int i = 0; i < workers; i++ )
+    {
+        if ( pthread_create( &threads[n_workers], NULL, worker_main, this ) != 0 )
+        {
+            fprintf( stderr, "FmPool: cannot create worker %d, continuing with %d\n", i, n_workers );
+            break;
+        }
+        n_workers++;
+    }
+}
+
+FmPool::~FmPool()
+{
+    pthread_mutex_lock( &lock );
+    quit = 1;
+    pthread_cond_broadcast( &start );
+    pthread_mutex_unlock( &lock );
+
+    for ( int i = 0; i < n_workers; i++ )
+    {
+        pthread_join( threads[i], NULL );
+    }
+
+    pthread_cond_destroy( &done );
+    pthread_cond_destroy( &start );
+    pthread_mutex_destroy( &lock );
+}
+
+// claims and runs one task of the current run; called with the lock held,
+// returns 0 when there was nothing left to claim
+int FmPool::run_one()
+{
+    if ( next_task >= n_tasks ) return 0;
+
+    const int k = next_task++;
+    pthread_mutex_unlock( &lock );
+
+    task_fn[k]( task_arg[k] );
+
+    pthread_mutex_lock( &lock );
+    if ( --pending == 0 )
+    {
+        pthread_cond_signal( &done );
+    }
+    return 1;
+}
+
+void *FmPool::worker_main( void *arg )
+{
+    FmPool *pool = (FmPool *)arg;
+
+    pthread_mutex_lock( &pool->lock );
+    while ( !pool->quit )
+    {
+        if ( !pool->run_one() )
+        {
+            pthread_cond_wait( &pool->start, &pool->lock );
+        }
+    }
+    pthread_mutex_unlock( &pool->lock );
+
+    return NULL;
+}
+
+void FmPool::run( const fm_task *fn, void *const *arg, int n )
+{
+    // more tasks than slots run as consecutive batches
+    for ( ; n > FM_POOL_MAX_TASKS; fn += FM_POOL_MAX_TASKS, arg += FM_POOL_MAX_TASKS, n -= FM_POOL_MAX_TASKS )
+    {
+        run( fn, arg, FM_POOL_MAX_TASKS );
+    }
+
+    pthread_mutex_lock( &lock );
+
+    for ( int k = 0; k < n; k++ )
+    {
+        task_fn[k]  = fn[k];
+        task_arg[k] = arg[k];
+    }
+    n_tasks   = n;
+    next_task = 0;
+    pending   = n;
+    if ( n_workers > 0 ) pthread_cond_broadcast( &start );
+
+    while ( run_one() ) { }
+
+    while ( pending > 0 )
+    {
+        pthread_cond_wait( &done, &lock );
+    }
+
+    n_tasks   = 0;
+    next_task = 0;
+    pthread_mutex_unlock( &lock );
+}
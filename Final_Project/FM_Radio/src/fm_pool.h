@@ -0,0 +1,53 @@
+#ifndef __FM_POOL_H__
+#define __FM_POOL_H__
+
+#include <pthread.h>
+
+// -------------------------------------------------------
+// Persistent worker pool for the fork/join sections of the
+// receiver graph. The threads are created once and sleep on
+// a condition variable between calls, so running a set of
+// branches costs one wake-up instead of a thread per block.
+// -------------------------------------------------------
+
+#define FM_POOL_MAX_WORKERS 8
+#define FM_POOL_MAX_TASKS   8
+
+typedef void (*fm_task)( void *arg );
+
+class FmPool
+{
+public:
+    // workers: threads besides the caller (clamped to 0..FM_POOL_MAX_WORKERS)
+    FmPool( int workers );
+    ~FmPool();
+
+    // Runs fn[k](arg[k]) for k = 0..n-1 concurrently and returns once every
+    // task has finished. The calling thread takes tasks as well.
+    void run( const fm_task *fn, void *const *arg, int n );
+
+    int workers() const { return n_workers; }
+
+private:
+    FmPool( const FmPool & );
+    FmPool & operator=( const FmPool & );
+
+    static void *worker_main( void *arg );
+    int run_one();
+
+    pthread_mutex_t lock;
+    pthread_cond_t  start;
+    pthread_cond_t  done;
+
+    fm_task task_fn[FM_POOL_MAX_TASKS];
+    void   *task_arg[FM_POOL_MAX_TASKS];
+    int n_tasks;        // tasks of the current run
+    int next_task;      // next task not yet claimed
+    int pending;        // tasks not yet finished
+    int quit;
+
+    pthread_t threads[FM_POOL_MAX_WORKERS];
+    int n_workers;
+};
+
+#endif
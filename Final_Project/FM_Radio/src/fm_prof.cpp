@@ -0,0 +1,149 @@
+
+#ifdef FM_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "fm_radio.h"
+#include "fm_prof.h"
+
+struct prof_stage
+{
+    const char *name;
+    int rate;           // samples per second the stage has to keep up with
+};
+
+static const prof_stage stages[FM_STAGES] =
+{
+    { "read_IQ",            QUAD_RATE },
+    { "fir_cmplx channel",  QUAD_RATE },
+    { "demodulate_n",       QUAD_RATE },
+    { "fir_n audio_lpr",    QUAD_RATE },
+    { "fir_n bp_lmr",       QUAD_RATE },
+    { "fir_n bp_pilot",     QUAD_RATE },
+    { "multiply_n square",  QUAD_RATE },
+    { "fir_n hp",           QUAD_RATE },
+    { "pll_carrier_n",      QUAD_RATE },
+    { "multiply_n mix",     QUAD_RATE },
+    { "fir_n audio_lmr",    QUAD_RATE },
+    { "add_n",              AUDIO_RATE },
+    { "sub_n",              AUDIO_RATE },
+    { "deemphasis_n left",  AUDIO_RATE },
+    { "deemphasis_n right", AUDIO_RATE },
+    { "gain_n left",        AUDIO_RATE },
+    { "gain_n right",       AUDIO_RATE },
+    { "stereo_out_n",       AUDIO_RATE },
+    { "pack_s16",           AUDIO_RATE },
+};
+
+// relaxed atomics: the branch stages run on pool workers
+static std::atomic<uint64_t> prof_ns[FM_STAGES];
+static std::atomic<uint64_t> prof_calls[FM_STAGES];
+static std::atomic<uint64_t> prof_samples[FM_STAGES];
+
+static const char *prof_path = NULL;
+static uint64_t prof_t_start = 0;
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+uint64_t fm_prof_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void fm_prof_add( fm_stage stage, long samples, uint64_t ns )
+{
+    prof_ns[stage].fetch_add( ns, std::memory_order_relaxed );
+    prof_calls[stage].fetch_add( 1, std::memory_order_relaxed );
+    prof_samples[stage].fetch_add( (uint64_t)samples, std::memory_order_relaxed );
+}
+
+void fm_prof_report( const char *path )
+{
+    pthread_mutex_lock( &prof_lock );
+
+    FILE *f = (path != NULL) ? fopen( path, "w" ) : stderr;
+    if ( f == NULL )
+    {
+        fprintf( stderr, "fm_prof: cannot write %s\n", path );
+        pthread_mutex_unlock( &prof_lock );
+        return;
+    }
+
+    const double wall = (fm_prof_now() - prof_t_start) * 1e-9;
+    const double quad = (double)prof_samples[FM_ST_READ_IQ].load();
+    double total_ns = 0;
+    int first = 1;
+
+    fprintf( f, "{\n  \"wall_s\": %.6f,\n  \"stages\": [\n", wall );
+    for ( int k = 0; k < FM_STAGES; k++ )
+    {
+        const uint64_t calls = prof_calls[k].load();
+        const double ns = (double)prof_ns[k].load();
+        const double samples = (double)prof_samples[k].load();
+        if ( calls == 0 ) continue;
+
+        const double rate = (ns > 0) ? samples * 1e9 / ns : 0;
+        total_ns += ns;
+        fprintf( f, "%s    { \"stage\": \"%s\", \"calls\": %llu, \"samples\": %.0f, \"ns\": %.0f, "
+                    "\"ns_per_sample\": %.3f, \"samples_per_s\": %.0f, \"headroom\": %.2f }",
+                 first ? "" : ",\n", stages[k].name, (unsigned long long)calls, samples, ns,
+                 (samples > 0) ? ns / samples : 0.0, rate, rate / stages[k].rate );
+        first = 0;
+    }
+
+    // cpu time summed over the stages, per input sample at the quad rate
+    const double per_sample = (quad > 0) ? total_ns / quad : 0;
+    fprintf( f, "\n  ],\n  \"total\": { \"samples\": %.0f, \"cpu_ns\": %.0f, \"ns_per_sample\": %.3f, "
+                "\"samples_per_s\": %.0f, \"headroom\": %.2f }\n}\n",
+             quad, total_ns, per_sample, (per_sample > 0) ? 1e9 / per_sample : 0.0,
+             (per_sample > 0) ? 1e9 / per_sample / QUAD_RATE : 0.0 );
+
+    if ( f != stderr ) fclose( f );
+    pthread_mutex_unlock( &prof_lock );
+}
+
+static void prof_at_exit()
+{
+    fm_prof_report( prof_path );
+}
+
+static void *prof_signal_main( void *arg )
+{
+    sigset_t *set = (sigset_t *)arg;
+    int sig = 0;
+
+    while ( sigwait( set, &sig ) == 0 )
+    {
+        fm_prof_report( prof_path );
+    }
+    return NULL;
+}
+
+void fm_prof_start( const char *path )
+{
+    static sigset_t set;
+    pthread_t thread;
+
+    prof_path = path;
+    prof_t_start = fm_prof_now();
+
+    sigemptyset( &set );
+    sigaddset( &set, SIGUSR1 );
+    pthread_sigmask( SIG_BLOCK, &set, NULL );
+    if ( pthread_create( &thread, NULL, prof_signal_main, &set ) == 0 )
+    {
+        pthread_detach( thread );
+    }
+
+    atexit( prof_at_exit );
+}
+
+#endif // FM_PROFILE
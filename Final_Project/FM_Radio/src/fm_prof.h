@@ -0,0 +1,80 @@
+#ifndef __FM_PROF_H__
+#define __FM_PROF_H__
+
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Per-stage timing of the receiver graph.
+//
+// Built with -DFM_PROFILE (make PROFILE=1), every stage call
+// in FmReceiver and FmPipeline is wrapped in a pair of
+// clock_gettime() reads and its time and sample count are
+// added to process-wide counters. Without it FM_PROF() is the
+// bare call and the fm_prof_* functions are empty inlines, so
+// a normal build carries no trace of it.
+//
+// The report is JSON: per stage the calls, samples, ns/sample,
+// samples/s and headroom (how many times faster than its
+// real-time rate the stage runs), plus the totals. Per-channel
+// audio stages (deemphasis, gain) are separate L and R stages,
+// each held to the rate of one channel. It is written at exit
+// and whenever the process gets SIGUSR1.
+// -------------------------------------------------------
+
+enum fm_stage
+{
+    FM_ST_READ_IQ,
+    FM_ST_CHANNEL,
+    FM_ST_DEMOD,
+    FM_ST_LPR,
+    FM_ST_BP_LMR,
+    FM_ST_BP_PILOT,
+    FM_ST_SQUARE,
+    FM_ST_HP,
+    FM_ST_NCO,
+    FM_ST_MIX,
+    FM_ST_LMR,
+    FM_ST_ADD,
+    FM_ST_SUB,
+    FM_ST_DEEMPH_L,
+    FM_ST_DEEMPH_R,
+    FM_ST_GAIN_L,
+    FM_ST_GAIN_R,
+    FM_ST_STEREO_OUT,
+    FM_ST_PACK,
+    FM_STAGES
+};
+
+#ifdef FM_PROFILE
+
+uint64_t fm_prof_now();
+void fm_prof_add( fm_stage stage, long samples, uint64_t ns );
+
+// Runs one stage call and charges its time to stage.
+#define FM_PROF( stage, samples, ... )                              \
+    do                                                              \
+    {                                                               \
+        const uint64_t prof_t0_ = fm_prof_now();                    \
+        __VA_ARGS__;                                                \
+        fm_prof_add( stage, samples, fm_prof_now() - prof_t0_ );    \
+    }                                                               \
+    while ( 0 )
+
+// Writes the report to path (stderr when NULL) at exit and on SIGUSR1.
+// Call before any other thread is started: SIGUSR1 is blocked in the
+// caller (and so in every thread created later) and taken by a reporter
+// thread.
+void fm_prof_start( const char *path );
+
+void fm_prof_report( const char *path );
+
+#else
+
+#define FM_PROF( stage, samples, ... ) __VA_ARGS__
+
+inline void fm_prof_start( const char * ) {}
+inline void fm_prof_report( const char * ) {}
+
+#endif
+
+#endif
@@ -3,46 +3,174 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "fm_radio.h"
+#include "fm_fixed.h"
+#include "fm_simd.h"
+#include "fm_pool.h"
+#include "fm_prof.h"
 
 
 
-void fm_radio_stereo(unsigned char *IQ, int *left_audio, int *right_audio)
+static short saturate_s16( int x )
+{
+    return (short)((x > 32767) ? 32767 : (x < -32768) ? -32768 : x);
+}
+
+static void pack_s16( const int *left, const int *right, const int n, short *pcm )
 {
-    // static input/output arrays
-    static int I[SAMPLES];
-    static int Q[SAMPLES];
-    static int I_fir[SAMPLES];
-    static int Q_fir[SAMPLES];
-    static int demod[SAMPLES];
-    static int bp_pilot_filter[SAMPLES];
-    static int bp_lmr_filter[SAMPLES];
-    static int hp_pilot_filter[SAMPLES];
-    static int audio_lpr_filter[AUDIO_SAMPLES];
-    static int audio_lmr_filter[AUDIO_SAMPLES];
-    static int square[SAMPLES];
-    static int multiply[SAMPLES];
-    static int left[AUDIO_SAMPLES];
-    static int right[AUDIO_SAMPLES];
-    static int left_deemph[AUDIO_SAMPLES];
-    static int right_deemph[AUDIO_SAMPLES];
-    
-    // static internal arrays
-    static int fir_cmplx_x_real[MAX_TAPS];
-    static int fir_cmplx_x_imag[MAX_TAPS];
-    static int demod_real[] = {0};
-    static int demod_imag[] = {0};
-    static int fir_lpr_x[MAX_TAPS];
-    static int fir_lmr_x[MAX_TAPS];
-    static int fir_bp_x[MAX_TAPS];
-    static int fir_pilot_x[MAX_TAPS];
-    static int fir_hp_x[MAX_TAPS];
-    static int deemph_l_x[MAX_TAPS];
-    static int deemph_l_y[MAX_TAPS];
-    static int deemph_r_x[MAX_TAPS];
-    static int deemph_r_y[MAX_TAPS];
+    for ( int i = 0; i < n; i++ )
+    {
+        pcm[2*i+0] = saturate_s16( left[i] );
+        pcm[2*i+1] = saturate_s16( right[i] );
+    }
+}
 
+FmReceiver::FmReceiver( int block_samples )
+{
+    // the audio decimator consumes whole AUDIO_DECIM groups
+    block = block_samples - (block_samples % AUDIO_DECIM);
+    if ( block < AUDIO_DECIM )
+    {
+        block = AUDIO_DECIM;
+    }
+
+    const int audio_block = block / AUDIO_DECIM;
+    scratch = new int[10 * block + 6 * audio_block + 2 * FIR_PREFIX];
+
+    // I and Q keep room for the channel filter history in front of them
+    int *p = scratch;
+    I                = p + FIR_PREFIX; p += FIR_PREFIX + block;
+    Q                = p + FIR_PREFIX; p += FIR_PREFIX + block;
+    I_fir            = p; p += block;
+    Q_fir            = p; p += block;
+    demod            = p; p += block;
+    bp_pilot_filter  = p; p += block;
+    bp_lmr_filter    = p; p += block;
+    hp_pilot_filter  = p; p += block;
+    square           = p; p += block;
+    multiply         = p; p += block;
+    audio_lpr_filter = p; p += audio_block;
+    audio_lmr_filter = p; p += audio_block;
+    left_raw         = p; p += audio_block;
+    right_raw        = p; p += audio_block;
+    left_deemph      = p; p += audio_block;
+    right_deemph     = p; p += audio_block;
+
+    pilot_fused = 1;
+    output_fused = 1;
+    carrier = FM_CARRIER_FILTER;
+    pool = NULL;
+    branch_n = 0;
+    set_tile_samples( GRAPH_TILE );
+    fir_cmplx_setup( &fir_channel, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, CHANNEL_COEFF_TAPS, 1 );
+    fir_setup( &fir_lpr, AUDIO_LPR_COEFFS, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM );
+    fir_setup( &fir_lmr, AUDIO_LMR_COEFFS, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM );
+    fir_setup( &fir_bp, BP_LMR_COEFFS, BP_LMR_COEFF_TAPS, 1 );
+    fir_setup( &fir_pilot, BP_PILOT_COEFFS, BP_PILOT_COEFF_TAPS, 1 );
+    fir_setup( &fir_hp, HP_COEFFS, HP_COEFF_TAPS, 1 );
+    pll_setup( &pll );
+    reset();
+}
+
+FmReceiver::~FmReceiver()
+{
+    delete pool;
+    delete [] scratch;
+}
+
+void FmReceiver::reset()
+{
+    fir_cmplx_reset( &fir_channel );
+    demod_real[0] = 0;
+    demod_imag[0] = 0;
+    fir_reset( &fir_lpr );
+    fir_reset( &fir_lmr );
+    fir_reset( &fir_bp );
+    fir_reset( &fir_pilot );
+    fir_reset( &fir_hp );
+    pll_reset( &pll );
+    memset( deemph_l_x, 0, sizeof(deemph_l_x) );
+    memset( deemph_l_y, 0, sizeof(deemph_l_y) );
+    memset( deemph_r_x, 0, sizeof(deemph_r_x) );
+    memset( deemph_r_y, 0, sizeof(deemph_r_y) );
+}
+
+void FmReceiver::set_fir_fold( fir_fold fold )
+{
+    fir_cmplx_set_fold( &fir_channel, fold );
+    fir_set_fold( &fir_lpr, fold );
+    fir_set_fold( &fir_lmr, fold );
+    fir_set_fold( &fir_bp, fold );
+    fir_set_fold( &fir_pilot, fold );
+    fir_set_fold( &fir_hp, fold );
+}
+
+void FmReceiver::set_tile_samples( int samples )
+{
+    samples -= samples % AUDIO_DECIM;
+    tile = (samples <= 0 || samples > block) ? block : samples;
+}
+
+int FmReceiver::set_threads( int threads )
+{
+    delete pool;
+    pool = NULL;
+
+    if ( threads > 1 )
+    {
+        pool = new FmPool( threads - 1 );
+    }
+
+    return this->threads();
+}
+
+int FmReceiver::threads() const
+{
+    return (pool != NULL) ? pool->workers() + 1 : 1;
+}
+
+int FmReceiver::process( const uint8_t *iq, size_t n, int *left, int *right )
+{
+    return run( iq, n, left, right, NULL );
+}
+
+int FmReceiver::process_s16( const uint8_t *iq, size_t n, short *pcm )
+{
+    return run( iq, n, NULL, NULL, pcm );
+}
+
+int FmReceiver::run( const uint8_t *iq, size_t n, int *left, int *right, short *pcm )
+{
+    size_t total = n - (n % AUDIO_DECIM);
+    size_t done = 0;
+
+    // every stage of one tile runs before the next tile starts
+    while ( done < total )
+    {
+        int count = (total - done < (size_t)tile) ? (int)(total - done) : tile;
+
+        process_block( &iq[done*4], count, left, right, pcm );
+
+        if ( left != NULL )
+        {
+            left  += count / AUDIO_DECIM;
+            right += count / AUDIO_DECIM;
+        }
+        if ( pcm != NULL )
+        {
+            pcm += 2 * (count / AUDIO_DECIM);
+        }
+        done  += count;
+    }
+
+    return (int)(total / AUDIO_DECIM);
+}
+
+void FmReceiver::process_block( const uint8_t *iq, int n, int *left, int *right, short *pcm )
+{
+    const int n_audio = n / AUDIO_DECIM;
 
     // f(t) = k * m(t) + fc
     //        m(t): the input signal
@@ -53,87 +181,198 @@ void fm_radio_stereo(unsigned char *IQ, int *left_audio, int *right_audio)
     //    (2) Compute the instantaneous frequency of the baseband signal.
 
     // read the I/Q data from the buffer
-    read_IQ( IQ, I, Q, SAMPLES );
+    FM_PROF( FM_ST_READ_IQ, n, read_IQ( iq, I, Q, n ) );
 
     // Channel low-pass filter cuts off all frequnties above 80 Khz
-    fir_cmplx_n( I, Q, SAMPLES, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, fir_cmplx_x_real, fir_cmplx_x_imag, CHANNEL_COEFF_TAPS, 1, I_fir, Q_fir ); 
+    FM_PROF( FM_ST_CHANNEL, n, fir_cmplx_filter_prefixed( &fir_channel, I, Q, n, I_fir, Q_fir ) );
 
     // demodulate
-    demodulate_n( I_fir, Q_fir, demod_real, demod_imag, SAMPLES, FM_DEMOD_GAIN, demod );
-
-    // L+R low-pass FIR filter - reduce sampling rate from 256 KHz to 32 KHz
-    fir_n( demod, SAMPLES, AUDIO_LPR_COEFFS, fir_lpr_x, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM, audio_lpr_filter ); 
+    FM_PROF( FM_ST_DEMOD, n, demodulate_n( I_fir, Q_fir, demod_real, demod_imag, n, FM_DEMOD_GAIN, demod ) );
 
-    // L-R band-pass filter extracts the L-R channel from 23kHz to 53kHz
-    fir_n( demod, SAMPLES, BP_LMR_COEFFS, fir_bp_x, BP_LMR_COEFF_TAPS, 1, bp_lmr_filter ); 
-
-    // Pilot band-pass filter extracts the 19kHz pilot tone
-    fir_n( demod, SAMPLES, BP_PILOT_COEFFS, fir_pilot_x, BP_PILOT_COEFF_TAPS, 1, bp_pilot_filter ); 
-
-    // square the pilot tone to get 38kHz
-    multiply_n( bp_pilot_filter, bp_pilot_filter, SAMPLES, square );
+    if ( pool != NULL )
+    {
+        // the three branches only share the (read-only) demod signal
+        static const fm_task branches[3] = { branch_pilot, branch_lmr, branch_lpr };
+        void *const args[3] = { this, this, this };
 
-    // high-pass filter removes the tone at 0Hz created after the pilot tone is squared
-    fir_n( square, SAMPLES, HP_COEFFS, fir_hp_x, HP_COEFF_TAPS, 1, hp_pilot_filter ); 
+        branch_n = n;
+        pool->run( branches, args, 3 );
 
-    // demodulate the L-R channel from 38kHz to baseband
-    multiply_n( hp_pilot_filter, bp_lmr_filter, SAMPLES, multiply );
+        // demodulate the L-R channel from 38kHz to baseband
+        FM_PROF( FM_ST_MIX, n, multiply_n( hp_pilot_filter, bp_lmr_filter, n, multiply ) );
+    }
+    else
+    {
+        // L+R low-pass FIR filter - reduce sampling rate from 256 KHz to 32 KHz
+        FM_PROF( FM_ST_LPR, n, fir_filter_n( &fir_lpr, demod, n, audio_lpr_filter ) );
+
+        if ( pilot_fused )
+        {
+            // pilot recovery and L-R demodulation, tile by tile
+            pilot_lmr_fused( demod, n, multiply );
+        }
+        else
+        {
+            // L-R band-pass filter extracts the L-R channel from 23kHz to 53kHz
+            FM_PROF( FM_ST_BP_LMR, n, fir_filter_n( &fir_bp, demod, n, bp_lmr_filter ) );
+
+            if ( carrier == FM_CARRIER_NCO )
+            {
+                // 38kHz from the NCO locked to the pilot tone
+                FM_PROF( FM_ST_NCO, n, pll_carrier_n( &pll, demod, n, hp_pilot_filter ) );
+            }
+            else
+            {
+                // Pilot band-pass filter extracts the 19kHz pilot tone
+                FM_PROF( FM_ST_BP_PILOT, n, fir_filter_n( &fir_pilot, demod, n, bp_pilot_filter ) );
+
+                // square the pilot tone to get 38kHz
+                FM_PROF( FM_ST_SQUARE, n, multiply_n( bp_pilot_filter, bp_pilot_filter, n, square ) );
+
+                // high-pass filter removes the tone at 0Hz created after the pilot tone is squared
+                FM_PROF( FM_ST_HP, n, fir_filter_n( &fir_hp, square, n, hp_pilot_filter ) );
+            }
+
+            // demodulate the L-R channel from 38kHz to baseband
+            FM_PROF( FM_ST_MIX, n, multiply_n( hp_pilot_filter, bp_lmr_filter, n, multiply ) );
+        }
+    }
 
     // L-R low-pass FIR filter - reduce sampling rate from 256 KHz to 32 KHz
-    fir_n( multiply, SAMPLES, AUDIO_LMR_COEFFS, fir_lmr_x, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM, audio_lmr_filter ); 
+    FM_PROF( FM_ST_LMR, n, fir_filter_n( &fir_lmr, multiply, n, audio_lmr_filter ) );
+
+    if ( output_fused )
+    {
+        // add / sub, deemphasis and volume of both channels in one pass
+        FM_PROF( FM_ST_STEREO_OUT, n_audio,
+                 stereo_out_n( audio_lpr_filter, audio_lmr_filter, n_audio, deemph_l_x, deemph_l_y, deemph_r_x, deemph_r_y,
+                               VOLUME_LEVEL, left, right, pcm ) );
+        return;
+    }
 
     // Left audio channel - (L+R) + (L-R) = 2L 
-    add_n( audio_lpr_filter, audio_lmr_filter, AUDIO_SAMPLES, left );
+    FM_PROF( FM_ST_ADD, n_audio, add_n( audio_lpr_filter, audio_lmr_filter, n_audio, left_raw ) );
 
     // Right audio channel - (L+R) - (L-R) = 2R
-    sub_n( audio_lpr_filter, audio_lmr_filter, AUDIO_SAMPLES, right );
+    FM_PROF( FM_ST_SUB, n_audio, sub_n( audio_lpr_filter, audio_lmr_filter, n_audio, right_raw ) );
 
     // Left channel deemphasis
-    deemphasis_n( left, deemph_l_x, deemph_l_y, AUDIO_SAMPLES, left_deemph );
+    FM_PROF( FM_ST_DEEMPH_L, n_audio, deemphasis_n( left_raw, deemph_l_x, deemph_l_y, n_audio, left_deemph ) );
 
     // Right channel deemphasis
-    deemphasis_n( right, deemph_r_x, deemph_r_y, AUDIO_SAMPLES, right_deemph );
+    FM_PROF( FM_ST_DEEMPH_R, n_audio, deemphasis_n( right_raw, deemph_r_x, deemph_r_y, n_audio, right_deemph ) );
+
+    // the raw arrays are free again and take the gain output if the caller
+    // only wants s16
+    int *left_out  = (left != NULL) ? left : left_raw;
+    int *right_out = (right != NULL) ? right : right_raw;
 
     // Left volume control
-    gain_n( left_deemph, AUDIO_SAMPLES, VOLUME_LEVEL, left_audio );
+    FM_PROF( FM_ST_GAIN_L, n_audio, gain_n( left_deemph, n_audio, VOLUME_LEVEL, left_out ) );
 
     // Right volume control
-    gain_n( right_deemph, AUDIO_SAMPLES, VOLUME_LEVEL, right_audio );
+    FM_PROF( FM_ST_GAIN_R, n_audio, gain_n( right_deemph, n_audio, VOLUME_LEVEL, right_out ) );
+
+    if ( pcm != NULL )
+    {
+        FM_PROF( FM_ST_PACK, n_audio, pack_s16( left_out, right_out, n_audio, pcm ) );
+    }
 }
 
 
-void read_IQ( unsigned char *IQ, int *I, int *Q, int samples )
+// BP_LMR, BP_PILOT, square, HP and the L-R mix run on PILOT_TILE samples at
+// a time, so the four intermediate signals stay in L1 instead of streaming
+// four SAMPLES-sized arrays through memory. Every filter carries its own
+// delay line across tiles, so the output equals the unfused chain exactly.
+void FmReceiver::pilot_lmr_fused( int *input, int n, int *output )
 {
     int i = 0;
-    for ( i = 0; i < samples; i++ )
+
+    for ( i = 0; i < n; i += PILOT_TILE )
     {
-        I[i] = QUANTIZE_I((short)(IQ[i*4+1] << 8) | (short)IQ[i*4+0]);
-        Q[i] = QUANTIZE_I((short)(IQ[i*4+3] << 8) | (short)IQ[i*4+2]);
+        const int count = (n - i < PILOT_TILE) ? (n - i) : PILOT_TILE;
+
+        FM_PROF( FM_ST_BP_LMR, count, fir_filter_n( &fir_bp, &input[i], count, tile_lmr ) );
+        if ( carrier == FM_CARRIER_NCO )
+        {
+            FM_PROF( FM_ST_NCO, count, pll_carrier_n( &pll, &input[i], count, tile_carrier ) );
+        }
+        else
+        {
+            FM_PROF( FM_ST_BP_PILOT, count, fir_filter_n( &fir_pilot, &input[i], count, tile_pilot ) );
+            FM_PROF( FM_ST_SQUARE, count, multiply_n( tile_pilot, tile_pilot, count, tile_square ) );
+            FM_PROF( FM_ST_HP, count, fir_filter_n( &fir_hp, tile_square, count, tile_carrier ) );
+        }
+        FM_PROF( FM_ST_MIX, count, multiply_n( tile_carrier, tile_lmr, count, &output[i] ) );
     }
 }
 
-void demodulate_n( int *real, int *imag, int *real_prev, int *imag_prev, const int n_samples, const int gain, int *demod_out )
+
+// L+R low-pass FIR filter - reduce sampling rate from 256 KHz to 32 KHz
+void FmReceiver::branch_lpr( void *arg )
 {
-    int i = 0;
+    FmReceiver *rx = (FmReceiver *)arg;
+    FM_PROF( FM_ST_LPR, rx->branch_n, fir_filter_n( &rx->fir_lpr, rx->demod, rx->branch_n, rx->audio_lpr_filter ) );
+}
 
-    for ( i = 0; i < n_samples; i++ )
+// L-R band-pass filter extracts the L-R channel from 23kHz to 53kHz
+void FmReceiver::branch_lmr( void *arg )
+{
+    FmReceiver *rx = (FmReceiver *)arg;
+    FM_PROF( FM_ST_BP_LMR, rx->branch_n, fir_filter_n( &rx->fir_bp, rx->demod, rx->branch_n, rx->bp_lmr_filter ) );
+}
+
+// pilot band-pass, square to 38kHz, high-pass to remove the 0Hz tone
+// (or the NCO when it is selected)
+void FmReceiver::branch_pilot( void *arg )
+{
+    FmReceiver *rx = (FmReceiver *)arg;
+    const int n = rx->branch_n;
+
+    if ( rx->carrier == FM_CARRIER_NCO )
     {
-        demodulate( real[i], imag[i], real_prev, imag_prev, gain, &demod_out[i] );
+        FM_PROF( FM_ST_NCO, n, pll_carrier_n( &rx->pll, rx->demod, n, rx->hp_pilot_filter ) );
+        return;
     }
+
+    FM_PROF( FM_ST_BP_PILOT, n, fir_filter_n( &rx->fir_pilot, rx->demod, n, rx->bp_pilot_filter ) );
+    FM_PROF( FM_ST_SQUARE, n, multiply_n( rx->bp_pilot_filter, rx->bp_pilot_filter, n, rx->square ) );
+    FM_PROF( FM_ST_HP, n, fir_filter_n( &rx->fir_hp, rx->square, n, rx->hp_pilot_filter ) );
 }
 
 
-void demodulate( int real, int imag, int *real_prev, int *imag_prev, const int gain, int *demod_out )
+void fm_radio_stereo(unsigned char *IQ, int *left_audio, int *right_audio)
 {
-    // k * atan(c1 * conj(c0))
-    int r = DEQUANTIZE(*real_prev * real) - DEQUANTIZE(-*imag_prev * imag);
-    int i = DEQUANTIZE(*real_prev * imag) + DEQUANTIZE(-*imag_prev * real);
-    
-    *demod_out = DEQUANTIZE(gain * qarctan(i, r));
+    static FmReceiver receiver( SAMPLES );
+
+    receiver.process( IQ, SAMPLES, left_audio, right_audio );
+}
 
-    // update the previous values
-    *real_prev = real;
-    *imag_prev = imag;
+
+void read_IQ( const unsigned char *IQ, int *I, int *Q, int samples )
+{
+    // deinterleave and QUANTIZE_I, vectorized
+    iq_unpack( IQ, samples, I, Q );
+}
+
+void demodulate_n( int *real, int *imag, int *real_prev, int *imag_prev, const int n_samples, const int gain, int *demod_out )
+{
+    if ( n_samples <= 0 )
+    {
+        return;
+    }
+
+    // division-free and vectorized, bit-exact with demodulate() per sample
+    demod_block( real, imag, n_samples, *real_prev, *imag_prev, gain, demod_out );
+
+    *real_prev = real[n_samples-1];
+    *imag_prev = imag[n_samples-1];
+}
+
+
+void demodulate( int real, int imag, int *real_prev, int *imag_prev, const int gain, int *demod_out )
+{
+    fixed_demodulate<int, BITS>( real, imag, real_prev, imag_prev, gain, demod_out );
 }
 
 void deemphasis_n( int *input, int *x, int *y, const int n_samples, int *output )
@@ -141,148 +380,376 @@ void deemphasis_n( int *input, int *x, int *y, const int n_samples, int *output
     iir_n( input, n_samples, IIR_X_COEFFS, IIR_Y_COEFFS, x, y, IIR_COEFF_TAPS, 1, output );
 }
 
+void stereo_out_n( const int *lpr, const int *lmr, const int n_samples, int *deemph_l_x, int *deemph_l_y,
+                   int *deemph_r_x, int *deemph_r_y, const int gain, int *left, int *right, short *pcm )
+{
+    stereo_out_block( lpr, lmr, n_samples, IIR_X_COEFFS, IIR_Y_COEFFS, deemph_l_x, deemph_l_y, deemph_r_x, deemph_r_y,
+                      gain, left, right, pcm );
+}
 
-void iir_n( int *x_in, const int n_samples, const int *x_coeffs, const int *y_coeffs, int *x, int *y, const int taps, int decimation, int *y_out )
+
+// -------------------------------------------------------
+// Delay line
+//
+// The filters keep their history newest-first in x[] (the layout
+// fir(), fir_cmplx() and iir() use). The block versions never shift
+// it per sample: the history is laid out oldest-first in front of
+// the first new samples, so output i of a block reads the window
+//     window[i*decimation + 0 .. i*decimation + taps-1]
+// with the newest sample last. Only the first few outputs need the
+// small ext[] copy; all later windows lie entirely inside x_in. At
+// the end of the block the newest taps samples go back into x[].
+// -------------------------------------------------------
+
+struct delay_window
+{
+    int ext[2*MAX_TAPS];    // history (oldest first) + first new samples
+    const int *head;        // window of output 0
+    const int *body;        // window of output n_head, inside x_in
+    int n_out;              // outputs in this block
+    int n_in;               // input samples consumed (n_out * decimation)
+    int n_head;             // outputs whose window starts in ext[]
+};
+
+static void delay_open( delay_window *w, const int *x, const int *x_in, const int n_samples, const int taps, const int decimation )
 {
-    int i = 0;
     int j = 0;
 
-    int n_elements = n_samples / decimation;
-    for ( ; i < n_elements; i++, j+=decimation )
+    w->n_out  = n_samples / decimation;
+    w->n_in   = w->n_out * decimation;
+    w->n_head = 0;
+    while ( w->n_head < w->n_out && w->n_head*decimation + decimation < taps )
     {
-        iir( &x_in[j], x_coeffs, y_coeffs, x, y, taps, decimation, &y_out[i] );
+        w->n_head++;
     }
+
+    const int n_copy = (w->n_in < taps) ? w->n_in : taps;
+    for ( j = 0; j < taps; j++ )
+    {
+        w->ext[j] = x[taps-j-1];
+    }
+    for ( j = 0; j < n_copy; j++ )
+    {
+        w->ext[taps+j] = x_in[j];
+    }
+
+    w->head = &w->ext[decimation];
+    w->body = (w->n_out > w->n_head) ? &x_in[w->n_head*decimation + decimation - taps] : NULL;
 }
 
-void iir( int *x_in, const int *x_coeffs, const int *y_coeffs, int *x, int *y, const int taps, const int decimation, int *y_out )
+static void delay_close( const delay_window *w, int *x, const int *x_in, const int taps )
 {
-    int y1 = 0;
-    int y2 = 0;
+    int j = 0;
+    for ( j = 0; j < taps; j++ )
+    {
+        const int k = w->n_in - j - 1;
+        x[j] = (k >= 0) ? x_in[k] : w->ext[taps+k];
+    }
+}
+
+
+void iir_n( int *x_in, const int n_samples, const int *x_coeffs, const int *y_coeffs, int *x, int *y, const int taps, int decimation, int *y_out )
+{
+    // feedback history, refilled per chunk instead of shifted per sample
+    const int CHUNK = 256;
+    int w_buf[MAX_TAPS + CHUNK];
+    int h_x[MAX_TAPS];
+    delay_window win;
     int i = 0;
     int j = 0;
-    
-    // shift x 
-    for ( j = taps-1; j > decimation-1; j-- ) 
+
+    // the feed-forward part is a FIR over the x window
+    for ( j = 0; j < taps; j++ )
     {
-        x[j] = x[j-decimation];
+        h_x[j] = x_coeffs[taps-j-1];
     }
 
-    for ( i = 0; i < decimation; i++ )
+    delay_open( &win, x, x_in, n_samples, taps, decimation );
+    fir_block( win.head, win.n_head, h_x, taps, decimation, y_out );
+    fir_block( win.body, win.n_out - win.n_head, h_x, taps, decimation, &y_out[win.n_head] );
+    delay_close( &win, x, x_in, taps );
+
+    // iir() keeps y[0] = w[n-1] while y[j] = w[n-j] for j >= 1, so the
+    // feedback is y_coeffs[0] and y_coeffs[1] on w[n-1], then y_coeffs[j] on w[n-j];
+    // the output is w[n-(taps-1)]
+    for ( j = 0; j < taps; j++ )
     {
-        x[decimation-i-1] = x_in[i];
+        w_buf[taps-j-1] = y[j];
     }
 
-    // shift y 
-    for ( j = taps-1; j > 0; j--)
+    for ( i = 0; i < win.n_out; i += CHUNK )
     {
-        y[j] = y[j-1];
+        const int n_chunk = (win.n_out - i < CHUNK) ? (win.n_out - i) : CHUNK;
+        int *w = &w_buf[taps];
+        int k = 0;
+
+        for ( k = 0; k < n_chunk; k++ )
+        {
+            int acc = y_out[i+k] + DEQUANTIZE( y_coeffs[0] * w[k-1] );
+            for ( j = 1; j < taps; j++ )
+            {
+                acc += DEQUANTIZE( y_coeffs[j] * w[k-j] );
+            }
+            w[k] = acc;
+            y_out[i+k] = w[k-taps+1];
+        }
+
+        for ( j = 0; j < taps; j++ )
+        {
+            w_buf[j] = w_buf[n_chunk+j];
+        }
     }
 
-    // get the new y
-    for ( i = 0; i < taps; i++ )
+    for ( j = 0; j < taps; j++ )
     {
-        y1 += DEQUANTIZE( x_coeffs[i] * x[i] );
-        y2 += DEQUANTIZE( y_coeffs[i] * y[i] );
+        y[j] = w_buf[taps-j-1];
     }
+}
 
-    y[0] = y1 + y2;
-        
-    *y_out = y[taps-1];
+void iir( int *x_in, const int *x_coeffs, const int *y_coeffs, int *x, int *y, const int taps, const int decimation, int *y_out )
+{
+    fixed_iir<int, BITS>( x_in, x_coeffs, y_coeffs, x, y, taps, decimation, y_out );
 }
 
 
 void fir_n( int *x_in, const int n_samples, const int *coeff, int *x, const int taps, const int decimation, int *y_out ) 
 {
-    int i = 0;
-    int j = 0;
+    delay_window win;
 
-    int n_elements = n_samples / decimation;
-    for ( i = 0; i < n_elements; i++, j+=decimation )
-    {
-        fir( &x_in[j], coeff, x, taps, decimation, &y_out[i] );
-    }
+    delay_open( &win, x, x_in, n_samples, taps, decimation );
+    fir_block( win.head, win.n_head, coeff, taps, decimation, y_out );
+    fir_block( win.body, win.n_out - win.n_head, coeff, taps, decimation, &y_out[win.n_head] );
+    delay_close( &win, x, x_in, taps );
 }
 
 
 void fir( int *x_in, const int *coeff, int *x, const int taps, const int decimation, int *y_out ) 
+{
+    fixed_fir<int, BITS>( x_in, coeff, x, taps, decimation, y_out );
+}
+
+int fir_is_symmetric( const int *coeff, const int taps )
 {
     int i = 0;
-    int j = 0;
-    int y = 0;
-    
-    // shift x
-    for ( j = taps-1; j > decimation-1; j-- ) 
+    for ( i = 0; i < taps/2; i++ )
     {
-        x[j] = x[j-decimation];
+        if ( coeff[i] != coeff[taps-i-1] )
+        {
+            return 0;
+        }
     }
+    return 1;
+}
 
-    for ( i = 0; i < decimation; i++ )
-    {
-        x[decimation-i-1] = x_in[i];
-    }
+void fir_setup( fir_filter *f, const int *coeff, const int taps, const int decimation, fir_fold fold )
+{
+    f->coeff      = coeff;
+    f->taps       = taps;
+    f->decimation = decimation;
+    f->symmetric  = fir_is_symmetric( coeff, taps );
+    fir_set_fold( f, fold );
+    fir_reset( f );
+}
+
+void fir_reset( fir_filter *f )
+{
+    memset( f->x, 0, sizeof(f->x) );
+}
+
+void fir_set_fold( fir_filter *f, fir_fold fold )
+{
+    f->fold = f->symmetric ? fold : FIR_FOLD_OFF;
+}
 
-    for ( j = 0; j < taps; j++ ) 
+void fir_filter_n( fir_filter *f, int *x_in, const int n_samples, int *y_out )
+{
+    delay_window win;
+
+    if ( f->fold == FIR_FOLD_OFF )
     {
-        y += DEQUANTIZE( coeff[taps-j-1] * x[j] );
+        fir_n( x_in, n_samples, f->coeff, f->x, f->taps, f->decimation, y_out );
+        return;
     }
-    
-    *y_out = y;
+
+    const int preadd = (f->fold == FIR_FOLD_PREADD);
+
+    delay_open( &win, f->x, x_in, n_samples, f->taps, f->decimation );
+    fir_block_folded( win.head, win.n_head, f->coeff, f->taps, f->decimation, preadd, y_out );
+    fir_block_folded( win.body, win.n_out - win.n_head, f->coeff, f->taps, f->decimation, preadd, &y_out[win.n_head] );
+    delay_close( &win, f->x, x_in, f->taps );
 }
 
-void fir_cmplx_n( int *x_real_in, int *x_imag_in, const int n_samples, const int *h_real, const int *h_imag,
-                  int *x_real, int *x_imag, const int taps, const int decimation, int *y_real_out, int *y_imag_out ) 
+fir_cmplx_kind fir_cmplx_classify( const int *h_real, const int *h_imag, const int taps )
 {
+    int real_zero = 1;
+    int imag_zero = 1;
     int i = 0;
-    int j = 0;
 
-    int n_elements = n_samples / decimation;
-    for ( ; i < n_elements; i++, j+=decimation )
+    for ( i = 0; i < taps; i++ )
     {
-        fir_cmplx( &x_real_in[j], &x_imag_in[j], h_real, h_imag, x_real, x_imag, taps, decimation, &y_real_out[i], &y_imag_out[i] );
+        if ( h_real[i] != 0 ) real_zero = 0;
+        if ( h_imag[i] != 0 ) imag_zero = 0;
     }
+
+    if ( imag_zero ) return FIR_CMPLX_REAL;
+    if ( real_zero ) return FIR_CMPLX_IMAG;
+    return FIR_CMPLX_GENERAL;
 }
 
-void fir_cmplx( int *x_real_in, int *x_imag_in, const int *h_real, const int *h_imag, int *x_real, int *x_imag,
-                const int taps, const int decimation, int *y_real_out, int *y_imag_out )
+// Window-ordered coefficients for fir_cmplx_run(). fir_cmplx() pairs h[0]
+// with the newest sample while the windows run oldest first, so the tables
+// are reversed. With h_real == 0 every product is -h_imag * x, hence the
+// negated table for the dual-real path.
+static void fir_cmplx_window_coeffs( const int *h_real, const int *h_imag, const int taps, const fir_cmplx_kind kind,
+                                     int *h_real_w, int *h_imag_w, int *h_dual_w )
 {
-    int i = 0;
     int j = 0;
-    int y_real = 0;
-    int y_imag = 0;
-    
-    // shift x
-    for ( j = taps-1; j > decimation-1; j-- ) 
+    for ( j = 0; j < taps; j++ )
     {
-        x_real[j] = x_real[j-decimation];
-        x_imag[j] = x_imag[j-decimation];
+        h_real_w[j] = h_real[taps-j-1];
+        h_imag_w[j] = h_imag[taps-j-1];
+        h_dual_w[j] = (kind == FIR_CMPLX_IMAG) ? -h_imag_w[j] : h_real_w[j];
     }
+}
 
-    for ( i = 0; i < decimation; i++ )
+// one contiguous run of windows through the kernel that fits the coefficients
+static void fir_cmplx_windows( const fir_cmplx_kind kind, const int *h_real_w, const int *h_imag_w, const int *h_dual_w,
+                               const fir_fold fold, const int *src_real, const int *src_imag, const int n_out, const int taps,
+                               const int decimation, int *y_real_out, int *y_imag_out )
+{
+    if ( kind != FIR_CMPLX_GENERAL && fold != FIR_FOLD_OFF )
     {
-        x_real[decimation-i-1] = x_real_in[i];
-        x_imag[decimation-i-1] = x_imag_in[i];
+        // symmetric dual-real coefficients: each rail through the folded FIR
+        const int preadd = (fold == FIR_FOLD_PREADD);
+        const int *src_a = (kind == FIR_CMPLX_REAL) ? src_real : src_imag;
+        const int *src_b = (kind == FIR_CMPLX_REAL) ? src_imag : src_real;
+        fir_block_folded( src_a, n_out, h_dual_w, taps, decimation, preadd, y_real_out );
+        fir_block_folded( src_b, n_out, h_dual_w, taps, decimation, preadd, y_imag_out );
     }
-
-    // compute new real & imag values
-    for ( i = 0; i < taps; i++ )
+    else if ( kind == FIR_CMPLX_REAL )
+    {
+        // I and Q filtered independently with h_real, in one pass
+        fir_dual_block( src_real, src_imag, n_out, h_dual_w, taps, decimation, y_real_out, y_imag_out );
+    }
+    else if ( kind == FIR_CMPLX_IMAG )
+    {
+        // y_real from the Q rail, y_imag from the I rail, both with -h_imag
+        fir_dual_block( src_imag, src_real, n_out, h_dual_w, taps, decimation, y_real_out, y_imag_out );
+    }
+    else
     {
-        y_real += DEQUANTIZE((h_real[i] * x_real[i]) - (h_imag[i] * x_imag[i]));
-        y_imag += DEQUANTIZE((h_real[i] * x_imag[i]) - (h_imag[i] * x_real[i]));
+        fir_cmplx_block( src_real, src_imag, n_out, h_real_w, h_imag_w, taps, decimation, y_real_out, y_imag_out );
     }
+}
+
+static void fir_cmplx_run( const fir_cmplx_kind kind, const int *h_real_w, const int *h_imag_w, const int *h_dual_w,
+                           const fir_fold fold, int *x_real_in, int *x_imag_in, const int n_samples, int *x_real, int *x_imag,
+                           const int taps, const int decimation, int *y_real_out, int *y_imag_out )
+{
+    delay_window win_real;
+    delay_window win_imag;
+
+    delay_open( &win_real, x_real, x_real_in, n_samples, taps, decimation );
+    delay_open( &win_imag, x_imag, x_imag_in, n_samples, taps, decimation );
 
-    *y_real_out = y_real;
-    *y_imag_out = y_imag;
+    const int n_head = win_real.n_head;
+    const int n_body = win_real.n_out - n_head;
+
+    fir_cmplx_windows( kind, h_real_w, h_imag_w, h_dual_w, fold, win_real.head, win_imag.head, n_head, taps, decimation,
+                       y_real_out, y_imag_out );
+    fir_cmplx_windows( kind, h_real_w, h_imag_w, h_dual_w, fold, win_real.body, win_imag.body, n_body, taps, decimation,
+                       &y_real_out[n_head], &y_imag_out[n_head] );
+
+    delay_close( &win_real, x_real, x_real_in, taps );
+    delay_close( &win_imag, x_imag, x_imag_in, taps );
 }
 
-void multiply_n( int *x_in, int *y_in, const int n_samples, int *output )
+void fir_cmplx_n( int *x_real_in, int *x_imag_in, const int n_samples, const int *h_real, const int *h_imag,
+                  int *x_real, int *x_imag, const int taps, const int decimation, int *y_real_out, int *y_imag_out ) 
 {
-    int i = 0;
-    for ( i = 0; i < n_samples; i++ )
+    int h_real_w[MAX_TAPS];
+    int h_imag_w[MAX_TAPS];
+    int h_dual_w[MAX_TAPS];
+
+    // no setup step here, the coefficient scan is cheap next to a block
+    const fir_cmplx_kind kind = fir_cmplx_classify( h_real, h_imag, taps );
+
+    fir_cmplx_window_coeffs( h_real, h_imag, taps, kind, h_real_w, h_imag_w, h_dual_w );
+    fir_cmplx_run( kind, h_real_w, h_imag_w, h_dual_w, FIR_FOLD_OFF, x_real_in, x_imag_in, n_samples, x_real, x_imag,
+                   taps, decimation, y_real_out, y_imag_out );
+}
+
+void fir_cmplx_setup( fir_cmplx_filter *f, const int *h_real, const int *h_imag, const int taps, const int decimation )
+{
+    f->h_real     = h_real;
+    f->h_imag     = h_imag;
+    f->taps       = taps;
+    f->decimation = decimation;
+    f->kind       = fir_cmplx_classify( h_real, h_imag, taps );
+    fir_cmplx_window_coeffs( h_real, h_imag, taps, f->kind, f->h_real_w, f->h_imag_w, f->h_dual_w );
+    f->symmetric  = (f->kind != FIR_CMPLX_GENERAL) && fir_is_symmetric( f->h_dual_w, taps );
+    fir_cmplx_set_fold( f, FIR_FOLD_OFF );
+    fir_cmplx_reset( f );
+}
+
+void fir_cmplx_reset( fir_cmplx_filter *f )
+{
+    memset( f->x_real, 0, sizeof(f->x_real) );
+    memset( f->x_imag, 0, sizeof(f->x_imag) );
+}
+
+void fir_cmplx_set_fold( fir_cmplx_filter *f, fir_fold fold )
+{
+    // the input is the QUANTIZEd int16 capture, where a pre-added tap pair
+    // overflows long before a single product does; fold it exactly instead
+    if ( fold == FIR_FOLD_PREADD ) fold = FIR_FOLD_EXACT;
+    f->fold = f->symmetric ? fold : FIR_FOLD_OFF;
+}
+
+void fir_cmplx_filter_n( fir_cmplx_filter *f, int *x_real_in, int *x_imag_in, const int n_samples, int *y_real_out, int *y_imag_out )
+{
+    fir_cmplx_run( f->kind, f->h_real_w, f->h_imag_w, f->h_dual_w, f->fold, x_real_in, x_imag_in, n_samples, f->x_real, f->x_imag,
+                   f->taps, f->decimation, y_real_out, y_imag_out );
+}
+
+void fir_cmplx_filter_prefixed( fir_cmplx_filter *f, int *x_real_in, int *x_imag_in, const int n_samples,
+                                int *y_real_out, int *y_imag_out )
+{
+    const int taps = f->taps;
+    const int decimation = f->decimation;
+    const int n_out = n_samples / decimation;
+    const int n_in = n_out * decimation;
+    int j = 0;
+
+    // the delay line goes oldest first right in front of the block, which
+    // makes every window of the block a slice of one array
+    for ( j = 0; j < taps; j++ )
+    {
+        x_real_in[j-taps] = f->x_real[taps-j-1];
+        x_imag_in[j-taps] = f->x_imag[taps-j-1];
+    }
+
+    fir_cmplx_windows( f->kind, f->h_real_w, f->h_imag_w, f->h_dual_w, f->fold, &x_real_in[decimation-taps], &x_imag_in[decimation-taps],
+                       n_out, taps, decimation, y_real_out, y_imag_out );
+
+    for ( j = 0; j < taps; j++ )
     {
-        output[i] = DEQUANTIZE( x_in[i] * y_in[i] );
+        f->x_real[j] = x_real_in[n_in-j-1];
+        f->x_imag[j] = x_imag_in[n_in-j-1];
     }
 }
 
+void fir_cmplx( int *x_real_in, int *x_imag_in, const int *h_real, const int *h_imag, int *x_real, int *x_imag,
+                const int taps, const int decimation, int *y_real_out, int *y_imag_out )
+{
+    fixed_fir_cmplx<int, BITS>( x_real_in, x_imag_in, h_real, h_imag, x_real, x_imag, taps, decimation, y_real_out, y_imag_out );
+}
+
+void multiply_n( int *x_in, int *y_in, const int n_samples, int *output )
+{
+    fixed_multiply_n<int, BITS>( x_in, y_in, n_samples, output );
+}
+
 
 void add_n( int *x_in, int *y_in, const int n_samples, int *output )
 {
@@ -302,36 +769,64 @@ void sub_n( int *x_in, int *y_in, const int n_samples, int *output )
     }
 }
 
-void gain_n( int *input, const int n_samples, int gain, int *output )
+void pll_setup( fm_pll *p )
 {
-    int i = 0;
-    for ( i = 0; i < n_samples; i++ )
-    {
-        output[i] = DEQUANTIZE(input[i] * gain) << (14-BITS);
-    }
+    p->step = (uint32_t)(((uint64_t)PILOT_HZ << 32) / QUAD_RATE);
+
+    // bp_lmr lags demod by the (taps-1)/2 group delay of BP_LMR; the carrier
+    // that multiplies it must be taken from the pilot phase that far back
+    p->lmr_offset = (uint32_t)(((uint64_t)p->step * (BP_LMR_COEFF_TAPS - 1)) / 2);
+    pll_reset( p );
 }
 
-int qarctan(int y, int x)
+void pll_reset( fm_pll *p )
 {
-    const int quad1 = QUANTIZE_F(PI / 4.0);
-    const int quad3 = QUANTIZE_F(3.0 * PI / 4.0);
+    p->phase = 0;
+    p->integ = 0;
+    p->acquire = PLL_ACQ_SAMPLES;
+}
 
-    int abs_y = abs(y) + 1;
-    int angle = 0; 
-    int r = 0;
+void pll_carrier_n( fm_pll *p, const int *demod, const int n_samples, int *carrier )
+{
+    const int quarter = 1 << 30;        // cos(x) = sin(x + 90 deg)
+    uint32_t phase = p->phase;
+    int64_t integ = p->integ;
+    int acquire = p->acquire;
+    int i = 0;
 
-    if ( x >= 0 ) 
-    {
-        r = QUANTIZE_I(x - abs_y) / (x + abs_y);
-        angle = quad1 - DEQUANTIZE(quad1 * r);
-    } 
-    else 
+    for ( i = 0; i < n_samples; i++ )
     {
-        r = QUANTIZE_I(x + abs_y) / (abs_y - x);
-        angle = quad3 - DEQUANTIZE(quad1 * r);
+        // L-R subcarrier: sin(2 * pilot phase). The MPX carries (L-R)/2 on it,
+        // so the mix needs amplitude 2.0 plus the loss of the demodulator's
+        // difference operator and of BP_LMR at 38 kHz (together 0.64).
+        const uint32_t sub = 2u * (phase - p->lmr_offset);
+        carrier[i] = DEQUANTIZE( sin_lut[sub >> 22] * PLL_CARRIER_GAIN );
+
+        // phase detector: pilot * cos(phase) ~ A/2 * sin(pilot - phase)
+        const int err = DEQUANTIZE( demod[i] * sin_lut[(phase + quarter) >> 22] );
+
+        // PI loop filter; wide (same damping) until the acquisition time is up
+        const int boost = (acquire > 0) ? PLL_ACQ_BOOST : 0;
+        if ( acquire > 0 ) acquire--;
+
+        integ += (int64_t)err << (2 * boost);
+        phase += p->step + ((uint32_t)(err * PLL_KP) << boost) + (uint32_t)(integ >> PLL_KI_SHIFT);
     }
 
-    return ((y < 0) ? -angle : angle);     // negate if in quad III or IV
+    p->phase = phase;
+    p->integ = integ;
+    p->acquire = acquire;
+}
+
+
+void gain_n( int *input, const int n_samples, int gain, int *output )
+{
+    fixed_gain_n<int, BITS>( input, n_samples, gain, output );
+}
+
+int qarctan(int y, int x)
+{
+    return fixed_qarctan<int, BITS>( y, x );
 }
 
 
@@ -3,6 +3,10 @@
 #define __FM_RADIO_H__
 
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+class FmPool;
 
 #define _VC_
 
@@ -21,17 +25,213 @@
 #define AUDIO_DECIM     8
 #define AUDIO_RATE      (int)(QUAD_RATE / AUDIO_DECIM) // 32 kHz
 #define VOLUME_LEVEL    QUANTIZE_F(1.0f)
-#define SAMPLES         65536*4
+#define SAMPLES         65536*4 // default block (~1 s of I/Q); FmReceiver takes any multiple of AUDIO_DECIM
 #define AUDIO_SAMPLES   (int)(SAMPLES / AUDIO_DECIM)
 #define MAX_TAPS        32 
+#define PILOT_TILE      2048    // samples per tile of the fused pilot / L-R stage (32 KB of intermediates)
+#define GRAPH_TILE      4096    // samples per tile of the whole receiver graph (~190 KB of scratch, L2-sized)
 #define MAX_DEV         55000.0f
 #define FM_DEMOD_GAIN   QUANTIZE_F( (float)QUAD_RATE / (2.0f * PI * MAX_DEV) )
 #define TAU             0.000075f
 #define W_PP            0.21140067f //tan( 1.0f / ((float)AUDIO_RATE*2.0f*TAU) )
+#define PILOT_HZ        19000
+#define PLL_KP          2048    // proportional loop gain, phase units (2^32 per cycle) per error LSB
+#define PLL_KI_SHIFT    4       // integrator gain 2^-PLL_KI_SHIFT phase units per error LSB
+#define PLL_ACQ_BOOST   3       // loop bandwidth x 2^PLL_ACQ_BOOST while acquiring
+#define PLL_ACQ_SAMPLES (QUAD_RATE / 8)
+#define PLL_CARRIER_GAIN QUANTIZE_F(2.0f / 0.64f)   // 2.0 over the 38 kHz gain of demod + BP_LMR
+
+// Folding variants for FIRs with linear-phase (symmetric) coefficients.
+//   FIR_FOLD_OFF    - direct form, one multiply per tap
+//   FIR_FOLD_EXACT  - mirrored taps share one coefficient fetch; still one
+//                     multiply per tap because DEQUANTIZE is applied to each
+//                     product, so the output is bit-exact
+//   FIR_FOLD_PREADD - h[k] * (x[k] + x[taps-1-k]), half the multiplies;
+//                     differs from the direct form by at most 1 LSB per tap
+//                     pair, i.e. |error| <= taps/2 per output
+enum fir_fold
+{
+    FIR_FOLD_OFF = 0,
+    FIR_FOLD_EXACT,
+    FIR_FOLD_PREADD
+};
+
+// Source of the 38 kHz carrier of the L-R demodulator.
+//   FM_CARRIER_FILTER - BP_PILOT -> square -> HP, the reference chain
+//   FM_CARRIER_NCO    - NCO phase-locked to the 19 kHz pilot, reading
+//                       sin_lut at twice the pilot phase; BP_PILOT and HP
+//                       are not run
+enum fm_carrier
+{
+    FM_CARRIER_FILTER = 0,
+    FM_CARRIER_NCO
+};
+
+// Second-order PLL on the pilot tone of the demodulated signal. The phase
+// detector is demod * cos(phase); the PI loop filter needs no band-pass in
+// front because the audio and the 38 kHz products average out inside its
+// few-Hz bandwidth.
+struct fm_pll
+{
+    uint32_t phase;         // pilot phase, 2^32 per cycle
+    uint32_t step;          // nominal phase step per sample (PILOT_HZ)
+    int64_t integ;          // loop filter integrator, phase units << PLL_KI_SHIFT
+    int acquire;            // samples left in the wide-band acquisition phase
+    uint32_t lmr_offset;    // carrier phase lag matching the BP_LMR group delay
+};
+
+// Real FIR filter prepared at setup: coefficient analysis is done once in
+// fir_setup() instead of on every call.
+struct fir_filter
+{
+    const int *coeff;
+    int taps;
+    int decimation;
+    int symmetric;          // coeff[k] == coeff[taps-1-k] for every k
+    fir_fold fold;          // used only when symmetric
+    int x[MAX_TAPS];        // delay line, same layout as fir()
+};
+
+// Coefficient structure of a complex FIR, found at setup.
+//   FIR_CMPLX_REAL - h_imag is all zero: I and Q are filtered independently
+//                    by one dual-real kernel
+//   FIR_CMPLX_IMAG - h_real is all zero: the rails swap and -h_imag is used
+enum fir_cmplx_kind
+{
+    FIR_CMPLX_GENERAL = 0,
+    FIR_CMPLX_REAL,
+    FIR_CMPLX_IMAG
+};
+
+// Complex FIR filter prepared at setup (fir_cmplx() arithmetic).
+struct fir_cmplx_filter
+{
+    const int *h_real;
+    const int *h_imag;
+    int taps;
+    int decimation;
+    fir_cmplx_kind kind;
+    int h_real_w[MAX_TAPS];     // window-ordered (reversed) coefficients
+    int h_imag_w[MAX_TAPS];
+    int h_dual_w[MAX_TAPS];     // coefficient of the dual-real path
+    int symmetric;              // h_dual_w is symmetric (dual-real kinds only)
+    fir_fold fold;              // used only when symmetric: each rail runs the folded FIR
+    int x_real[MAX_TAPS];       // delay lines, same layout as fir_cmplx()
+    int x_imag[MAX_TAPS];
+};
+
+// FM stereo receiver context. Owns every filter delay line and all of the
+// per-block scratch memory, so any number of receivers can run side by side
+// (e.g. one per thread). fm_radio_stereo() is a thin wrapper around a single
+// process-wide instance.
+class FmReceiver
+{
+public:
+    FmReceiver( int block_samples = SAMPLES );
+    ~FmReceiver();
+
+    // Demodulates n I/Q pairs (4 bytes each, interleaved little-endian int16)
+    // and writes n / AUDIO_DECIM samples to left and right. n may exceed the
+    // block size; it is then processed in tile-sized pieces. Trailing samples
+    // that do not fill a whole AUDIO_DECIM group are ignored.
+    // Returns the number of audio samples written per channel.
+    int process( const uint8_t *iq, size_t n, int *left, int *right );
+
+    // process() straight to n / AUDIO_DECIM frames of saturated interleaved
+    // s16 (left, right), the format of the audio outputs
+    int process_s16( const uint8_t *iq, size_t n, short *pcm );
+
+    // clear all filter and demodulator state
+    void reset();
+
+    // select the folding variant of the symmetric FIRs (default: off): the
+    // real FIRs and the channel filter, whose coefficients are real. Filter
+    // state is kept, so the variant can change between two blocks.
+    void set_fir_fold( fir_fold fold );
+
+    // select the 38 kHz carrier generator (default: FM_CARRIER_FILTER).
+    // The NCO output differs from the filter chain, so switching it off
+    // again is the way back to the golden reference.
+    void set_carrier( fm_carrier source ) { carrier = source; }
+
+    // run BP_PILOT -> square -> HP -> mix with BP_LMR as one tiled pass
+    // instead of four full-block passes (default: on, bit-exact either way)
+    void set_pilot_fused( int enable ) { pilot_fused = enable; }
+
+    // run add / sub -> deemphasis -> gain for both channels as one pass
+    // instead of six (default: on, bit-exact either way)
+    void set_output_fused( int enable ) { output_fused = enable; }
+
+    // run the whole graph on sub-blocks of this many samples (rounded down to
+    // a multiple of AUDIO_DECIM, at most the block size), so the scratch
+    // arrays touched by one pass stay in L2. Filter state carries across
+    // tiles, so the output does not depend on the tile size.
+    // 0 disables tiling (one pass per block).
+    void set_tile_samples( int samples );
+
+    // Run the AUDIO_LPR, BP_LMR and pilot (BP_PILOT -> square -> HP) branches
+    // of each tile concurrently on a persistent pool of threads - 1 workers,
+    // joining before the L-R mix. 1 runs everything on the calling thread
+    // (default). Returns the number of threads in effect.
+    int set_threads( int threads );
+
+    int block_samples() const { return block; }
+    int tile_samples() const { return tile; }
+    int threads() const;
+
+private:
+    FmReceiver( const FmReceiver & );
+    FmReceiver & operator=( const FmReceiver & );
+
+    int run( const uint8_t *iq, size_t n, int *left, int *right, short *pcm );
+    void process_block( const uint8_t *iq, int n, int *left, int *right, short *pcm );
+    void pilot_lmr_fused( int *input, int n, int *output );
+
+    // branches of the parallel section, fm_task signature (arg = receiver)
+    static void branch_lpr( void *arg );
+    static void branch_lmr( void *arg );
+    static void branch_pilot( void *arg );
+
+    int block;
+    int tile;
+    int pilot_fused;
+    int output_fused;
+    fm_carrier carrier;
+
+    FmPool *pool;       // NULL when single-threaded
+    int branch_n;       // samples of the tile the branches work on
+
+    // per-block scratch arrays (carved out of one allocation)
+    int *scratch;
+    int *I, *Q, *I_fir, *Q_fir, *demod;
+    int *bp_pilot_filter, *bp_lmr_filter, *hp_pilot_filter, *square, *multiply;
+    int *audio_lpr_filter, *audio_lmr_filter, *left_raw, *right_raw, *left_deemph, *right_deemph;
+
+    // L1-sized intermediates of the fused pilot / L-R stage
+    int tile_pilot[PILOT_TILE];
+    int tile_square[PILOT_TILE];
+    int tile_carrier[PILOT_TILE];
+    int tile_lmr[PILOT_TILE];
+
+    // filter and demodulator state carried between calls
+    fir_cmplx_filter fir_channel;
+    int demod_real[1];
+    int demod_imag[1];
+    fir_filter fir_lpr;
+    fir_filter fir_lmr;
+    fir_filter fir_bp;
+    fir_filter fir_pilot;
+    fir_filter fir_hp;
+    fm_pll pll;
+    int deemph_l_x[MAX_TAPS];
+    int deemph_l_y[MAX_TAPS];
+    int deemph_r_x[MAX_TAPS];
+    int deemph_r_y[MAX_TAPS];
+};
 
 void fm_radio_stereo( unsigned char *IQ, int *left_audio, int *right_audio );
 
-void read_IQ( unsigned char *IQ, int *I, int *Q, int samples );
+void read_IQ( const unsigned char *IQ, int *I, int *Q, int samples );
 
 void demodulate_n( int *real, int *imag, int *real_prev, int *imag_prev, const int n_samples, const int gain, int *demod_out );
 
@@ -39,6 +239,11 @@ void demodulate( int real, int imag, int *real_prev, int *imag_prev, const int g
 
 void deemphasis_n( int *input, int *x, int *y, const int n_samples, int *output );
 
+// add_n, sub_n, both deemphasis_n and both gain_n as one pass; writes left /
+// right and / or saturated interleaved s16 to pcm (either may be NULL)
+void stereo_out_n( const int *lpr, const int *lmr, const int n_samples, int *deemph_l_x, int *deemph_l_y,
+                   int *deemph_r_x, int *deemph_r_y, const int gain, int *left, int *right, short *pcm );
+
 void iir_n( int *x_in, const int n_samples, const int *x_coeffs, const int *y_coeffs, int *x, int *y, const int taps, int decimation, int *y_out );
 
 void iir( int *x_in, const int *x_coeffs, const int *y_coeffs, int *x, int *y, const int taps, const int decimation, int *y_out );
@@ -47,12 +252,52 @@ void fir_n( int *x_in, const int n_samples, const int *coeff, int *x, const int
 
 void fir( int *x_in, const int *coeff, int *x, const int taps, const int decimation, int *y_out ); 
 
+int fir_is_symmetric( const int *coeff, const int taps );
+
+void fir_setup( fir_filter *f, const int *coeff, const int taps, const int decimation, fir_fold fold = FIR_FOLD_OFF );
+
+void fir_reset( fir_filter *f );
+
+// change the folding variant only; the delay line is kept
+void fir_set_fold( fir_filter *f, fir_fold fold );
+
+void fir_filter_n( fir_filter *f, int *x_in, const int n_samples, int *y_out );
+
 void fir_cmplx_n( int *x_real_in, int *x_imag_in, const int n_samples, const int *h_real, const int *h_imag, int *x_real, int *x_imag,  
                   const int taps, const int decimation, int *y_real_out, int *y_imag_out );
 
 void fir_cmplx( int *x_real_in, int *x_imag_in, const int *h_real, const int *h_imag, int *x_real, int *x_imag, 
                 const int taps, const int decimation, int *y_real_out, int *y_imag_out );
 
+fir_cmplx_kind fir_cmplx_classify( const int *h_real, const int *h_imag, const int taps );
+
+void fir_cmplx_setup( fir_cmplx_filter *f, const int *h_real, const int *h_imag, const int taps, const int decimation );
+
+void fir_cmplx_reset( fir_cmplx_filter *f );
+
+// Folding for a filter whose coefficients are purely real or purely
+// imaginary and symmetric (the channel filter); ignored otherwise.
+// FIR_FOLD_PREADD runs as FIR_FOLD_EXACT: the pair sum of the QUANTIZEd
+// I/Q input overflows. The delay lines are kept.
+void fir_cmplx_set_fold( fir_cmplx_filter *f, fir_fold fold );
+
+void fir_cmplx_filter_n( fir_cmplx_filter *f, int *x_real_in, int *x_imag_in, const int n_samples, int *y_real_out, int *y_imag_out );
+
+// fir_cmplx_filter_n() on history-prefixed input: the taps ints in front of
+// x_real_in and x_imag_in are scratch that receive the delay line, so the
+// whole block is one window run with no head copy. Planes that read_IQ()
+// fills at offset FIR_PREFIX have this layout. Bit-exact with _n().
+#define FIR_PREFIX  MAX_TAPS
+
+void fir_cmplx_filter_prefixed( fir_cmplx_filter *f, int *x_real_in, int *x_imag_in, const int n_samples,
+                                int *y_real_out, int *y_imag_out );
+
+void pll_setup( fm_pll *p );
+
+void pll_reset( fm_pll *p );
+
+void pll_carrier_n( fm_pll *p, const int *demod, const int n_samples, int *carrier );
+
 void gain_n( int *input, const int n_samples, int gain, int *output );
 
 int qarctan(int y, int x);
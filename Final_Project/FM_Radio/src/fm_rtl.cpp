@@ -0,0 +1,452 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fm_radio.h"
+#include "fm_rtl.h"
+
+// register-chain latencies of the RTL modules (see the header)
+#define RTL_LAT_FIR         2
+#define RTL_LAT_DEMOD       40
+#define RTL_LAT_MULTIPLY    1
+#define RTL_LAT_ADD_SUB     2
+#define RTL_LAT_DEEMPH      3
+#define RTL_LAT_GAIN        1
+
+
+// -------------------------------------------------------
+// FIFO
+// -------------------------------------------------------
+
+RtlFifo::RtlFifo( const char *name, int depth )
+    : name( name ), depth( depth ), count( 0 ), high_water( 0 ), full_cycles( 0 ), buf( depth ), head( 0 )
+{
+}
+
+void RtlFifo::push( int v )
+{
+    int tail = head + count;
+    if ( tail >= depth ) tail -= depth;
+    buf[tail] = v;
+    count++;
+    if ( count > high_water ) high_water = count;
+}
+
+int RtlFifo::pop()
+{
+    const int v = buf[head];
+    if ( ++head == depth ) head = 0;
+    count--;
+    return v;
+}
+
+
+// -------------------------------------------------------
+// stage
+// -------------------------------------------------------
+
+RtlStage::RtlStage( const char *name, int latency )
+    : name( name ), latency( latency ), accepted( 0 ), produced( 0 ), busy_cycles( 0 ), stall_cycles( 0 ),
+      starve_cycles( 0 ), n_in( 0 ), n_out( 0 ), pipe( latency + 2 ), head( 0 ), in_flight( 0 ), busy_until( 0 )
+{
+}
+
+void RtlStage::input( RtlFifo *f )
+{
+    in[n_in++] = f;
+}
+
+void RtlStage::output( RtlFifo *f, int sel )
+{
+    out_sel[n_out] = sel;
+    out[n_out++] = f;
+}
+
+void RtlStage::step( long cycle )
+{
+    const int cap = (int)pipe.size();
+
+    // retire the oldest result; a full output freezes the whole stage, so the
+    // results behind it are pushed back by one cycle as well
+    if ( in_flight > 0 && pipe[head].ready <= cycle )
+    {
+        int room = 1;
+        for ( int k = 0; k < n_out; k++ )
+        {
+            if ( !out[k]->has_room() )
+            {
+                out[k]->full_cycles++;
+                room = 0;
+            }
+        }
+
+        if ( !room )
+        {
+            stall_cycles++;
+            busy_until++;
+            for ( int k = 0; k < in_flight; k++ )
+            {
+                pipe[(head + k) % cap].ready++;
+            }
+            return;
+        }
+
+        for ( int k = 0; k < n_out; k++ )
+        {
+            out[k]->push( pipe[head].y[out_sel[k]] );
+        }
+        if ( ++head == cap ) head = 0;
+        in_flight--;
+        produced++;
+    }
+
+    if ( busy_until > cycle )
+    {
+        busy_cycles++;
+        return;
+    }
+    if ( in_flight == cap )
+    {
+        return;
+    }
+    for ( int k = 0; k < n_in; k++ )
+    {
+        if ( !in[k]->has_data() )
+        {
+            starve_cycles++;
+            return;
+        }
+    }
+
+    int x[RTL_MAX_IN], y[2] = { 0, 0 };
+    int cost = 1;
+    for ( int k = 0; k < n_in; k++ )
+    {
+        x[k] = in[k]->pop();
+    }
+    accepted++;
+    busy_cycles++;
+
+    if ( compute( x, y, &cost ) )
+    {
+        int tail = head + in_flight;
+        if ( tail >= cap ) tail -= cap;
+        result &r = pipe[tail];
+        r.ready = cycle + (cost - 1) + latency;
+        r.y[0] = y[0];
+        r.y[1] = y[1];
+        in_flight++;
+    }
+    busy_until = cycle + cost;
+}
+
+
+// -------------------------------------------------------
+// modules
+// -------------------------------------------------------
+
+// fir.sv: x_reg shift register (x[0] newest), y = sum DEQUANTIZE(coeffs[TAPS-1-k] * x[k]),
+// one output per DECIM inputs on the last input of the group. lanes = 2 runs the I and Q
+// channel filters in lock step.
+class RtlFir : public RtlStage
+{
+public:
+    RtlFir( const char *name, const int *coeff, int taps, int decim, int lanes, int macs )
+        : RtlStage( name, RTL_LAT_FIR ), taps( taps ), decim( decim ), lanes( lanes ), cnt( 0 ), pos( 0 ),
+          coeff( taps ), hist( 2 * 2 * taps, 0 )
+    {
+        // coeffs[TAPS-1-k] pairs with x[k]: reversed once so the MAC loop runs forward
+        for ( int k = 0; k < taps; k++ )
+        {
+            this->coeff[k] = coeff[taps - 1 - k];
+        }
+        fold_cost = (macs > 0 && macs < taps) ? (taps + macs - 1) / macs : 1;
+    }
+
+protected:
+    int compute( const int *x, int *y, int *cost )
+    {
+        // window [pos, pos + taps) of each lane's doubled history stays contiguous
+        pos = (pos == 0) ? taps - 1 : pos - 1;
+        for ( int l = 0; l < lanes; l++ )
+        {
+            hist[l * 2 * taps + pos] = x[l];
+            hist[l * 2 * taps + pos + taps] = x[l];
+        }
+
+        if ( ++cnt < decim )
+        {
+            *cost = 1;
+            return 0;
+        }
+        cnt = 0;
+
+        for ( int l = 0; l < lanes; l++ )
+        {
+            const int *w = &hist[l * 2 * taps + pos];
+            int acc = 0;
+            for ( int k = 0; k < taps; k++ )
+            {
+                acc += DEQUANTIZE( coeff[k] * w[k] );
+            }
+            y[l] = acc;
+        }
+        *cost = fold_cost;
+        return 1;
+    }
+
+private:
+    int taps, decim, lanes, fold_cost;
+    int cnt, pos;
+    std::vector<int> coeff;
+    std::vector<int> hist;
+};
+
+class RtlDemod : public RtlStage
+{
+public:
+    RtlDemod() : RtlStage( "demodulate", RTL_LAT_DEMOD ), real_prev( 0 ), imag_prev( 0 ) {}
+
+protected:
+    int compute( const int *x, int *y, int *cost )
+    {
+        demodulate( x[0], x[1], &real_prev, &imag_prev, FM_DEMOD_GAIN, &y[0] );
+        *cost = 1;
+        return 1;
+    }
+
+private:
+    int real_prev, imag_prev;
+};
+
+// one input: x * x (pilot squarer), two inputs: x * y
+class RtlMultiply : public RtlStage
+{
+public:
+    RtlMultiply( const char *name, int square ) : RtlStage( name, RTL_LAT_MULTIPLY ), square( square ) {}
+
+protected:
+    int compute( const int *x, int *y, int *cost )
+    {
+        y[0] = DEQUANTIZE( x[0] * (square ? x[0] : x[1]) );
+        *cost = 1;
+        return 1;
+    }
+
+private:
+    int square;
+};
+
+// u_add and u_sub share their inputs: y[0] = left_raw, y[1] = right_raw
+class RtlAddSub : public RtlStage
+{
+public:
+    RtlAddSub() : RtlStage( "add_sub", RTL_LAT_ADD_SUB ) {}
+
+protected:
+    int compute( const int *x, int *y, int *cost )
+    {
+        y[0] = x[0] + x[1];
+        y[1] = x[0] - x[1];
+        *cost = 1;
+        return 1;
+    }
+};
+
+class RtlDeemph : public RtlStage
+{
+public:
+    RtlDeemph( const char *name ) : RtlStage( name, RTL_LAT_DEEMPH )
+    {
+        memset( xs, 0, sizeof(xs) );
+        memset( ys, 0, sizeof(ys) );
+    }
+
+protected:
+    int compute( const int *x, int *y, int *cost )
+    {
+        int in = x[0];
+        iir( &in, IIR_X_COEFFS, IIR_Y_COEFFS, xs, ys, IIR_COEFF_TAPS, 1, &y[0] );
+        *cost = 1;
+        return 1;
+    }
+
+private:
+    int xs[MAX_TAPS], ys[MAX_TAPS];
+};
+
+class RtlGain : public RtlStage
+{
+public:
+    RtlGain( const char *name ) : RtlStage( name, RTL_LAT_GAIN ) {}
+
+protected:
+    int compute( const int *x, int *y, int *cost )
+    {
+        y[0] = DEQUANTIZE( x[0] * VOLUME_LEVEL ) << (14 - BITS);
+        *cost = 1;
+        return 1;
+    }
+};
+
+
+// -------------------------------------------------------
+// top level
+// -------------------------------------------------------
+
+RtlFifo *FmRtlModel::link( const char *name )
+{
+    RtlFifo *f = new RtlFifo( name, cfg.fifo_depth );
+    fifos.push_back( f );
+    return f;
+}
+
+FmRtlModel::FmRtlModel( const rtl_config *c )
+    : cfg( *c ), cycle( 0 ), first_out( -1 ), last_out( -1 ), src_stalls( 0 ), src_max_delay( 0 )
+{
+    if ( cfg.cycles_per_sample < 1 ) cfg.cycles_per_sample = 1;
+    if ( cfg.fifo_depth < 1 ) cfg.fifo_depth = 1;
+    const int macs = cfg.fir_macs;
+
+    in_I = link( "in_I" );
+    in_Q = link( "in_Q" );
+    RtlFifo *ch_I     = link( "ch_I" );
+    RtlFifo *ch_Q     = link( "ch_Q" );
+    RtlFifo *d_lpr    = link( "demod>lpr" );
+    RtlFifo *d_pilot  = link( "demod>bp_pilot" );
+    RtlFifo *d_bp     = link( "demod>bp_lmr" );
+    RtlFifo *bp_pilot = link( "bp_pilot" );
+    RtlFifo *pilot_sq = link( "pilot_sq" );
+    RtlFifo *pilot    = link( "pilot_38k" );
+    RtlFifo *bp_lmr   = link( "bp_lmr" );
+    RtlFifo *lmr_bb   = link( "lmr_bb" );
+    RtlFifo *lpr      = link( "audio_lpr" );
+    RtlFifo *lmr      = link( "audio_lmr" );
+    RtlFifo *l_raw    = link( "left_raw" );
+    RtlFifo *r_raw    = link( "right_raw" );
+    RtlFifo *l_deemph = link( "left_deemph" );
+    RtlFifo *r_deemph = link( "right_deemph" );
+    out_L = link( "out_left" );
+    out_R = link( "out_right" );
+
+    RtlStage *s;
+
+    s = new RtlFir( "fir_ch", CHANNEL_COEFFS_REAL, CHANNEL_COEFF_TAPS, 1, 2, macs );
+    s->input( in_I ); s->input( in_Q ); s->output( ch_I, 0 ); s->output( ch_Q, 1 );
+    stages.push_back( s );
+
+    s = new RtlDemod();
+    s->input( ch_I ); s->input( ch_Q ); s->output( d_lpr ); s->output( d_pilot ); s->output( d_bp );
+    stages.push_back( s );
+
+    s = new RtlFir( "fir_lpr", AUDIO_LPR_COEFFS, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM, 1, macs );
+    s->input( d_lpr ); s->output( lpr );
+    stages.push_back( s );
+
+    s = new RtlFir( "fir_bppilot", BP_PILOT_COEFFS, BP_PILOT_COEFF_TAPS, 1, 1, macs );
+    s->input( d_pilot ); s->output( bp_pilot );
+    stages.push_back( s );
+
+    s = new RtlMultiply( "multiply_sq", 1 );
+    s->input( bp_pilot ); s->output( pilot_sq );
+    stages.push_back( s );
+
+    s = new RtlFir( "fir_hp", HP_COEFFS, HP_COEFF_TAPS, 1, 1, macs );
+    s->input( pilot_sq ); s->output( pilot );
+    stages.push_back( s );
+
+    s = new RtlFir( "fir_bplmr", BP_LMR_COEFFS, BP_LMR_COEFF_TAPS, 1, 1, macs );
+    s->input( d_bp ); s->output( bp_lmr );
+    stages.push_back( s );
+
+    s = new RtlMultiply( "multiply_lmr", 0 );
+    s->input( pilot ); s->input( bp_lmr ); s->output( lmr_bb );
+    stages.push_back( s );
+
+    s = new RtlFir( "fir_lmr", AUDIO_LMR_COEFFS, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM, 1, macs );
+    s->input( lmr_bb ); s->output( lmr );
+    stages.push_back( s );
+
+    s = new RtlAddSub();
+    s->input( lpr ); s->input( lmr ); s->output( l_raw, 0 ); s->output( r_raw, 1 );
+    stages.push_back( s );
+
+    s = new RtlDeemph( "deemph_L" );
+    s->input( l_raw ); s->output( l_deemph );
+    stages.push_back( s );
+
+    s = new RtlDeemph( "deemph_R" );
+    s->input( r_raw ); s->output( r_deemph );
+    stages.push_back( s );
+
+    s = new RtlGain( "gain_L" );
+    s->input( l_deemph ); s->output( out_L );
+    stages.push_back( s );
+
+    s = new RtlGain( "gain_R" );
+    s->input( r_deemph ); s->output( out_R );
+    stages.push_back( s );
+}
+
+FmRtlModel::~FmRtlModel()
+{
+    for ( size_t k = 0; k < stages.size(); k++ ) delete stages[k];
+    for ( size_t k = 0; k < fifos.size(); k++ ) delete fifos[k];
+}
+
+long FmRtlModel::run( const int *I, const int *Q, long n, int *left, int *right )
+{
+    const int n_stages = (int)stages.size();
+    long next = 0;          // next input sample
+    long produced = 0;
+
+    for ( ;; cycle++ )
+    {
+        // sink: the testbench takes both channels every cycle
+        if ( out_L->has_data() && out_R->has_data() )
+        {
+            if ( first_out < 0 ) first_out = cycle;
+            last_out = cycle;
+            left[produced] = out_L->pop();
+            right[produced] = out_R->pop();
+            produced++;
+        }
+
+        // downstream first, so a slot freed this cycle can be refilled this cycle
+        int busy = 0;
+        for ( int k = n_stages - 1; k >= 0; k-- )
+        {
+            stages[k]->step( cycle );
+            busy |= !stages[k]->idle();
+        }
+
+        // source: one I/Q pair every cycles_per_sample clocks, late when the
+        // channel filter FIFO is full
+        const long due = next * cfg.cycles_per_sample;
+        if ( next < n && cycle >= due )
+        {
+            if ( in_I->has_room() && in_Q->has_room() )
+            {
+                in_I->push( I[next] );
+                in_Q->push( Q[next] );
+                if ( cycle - due > src_max_delay ) src_max_delay = cycle - due;
+                next++;
+            }
+            else
+            {
+                src_stalls++;
+            }
+        }
+
+        if ( next == n && !busy )
+        {
+            int queued = 0;
+            for ( size_t k = 0; k < fifos.size() && !queued; k++ )
+            {
+                queued = fifos[k]->has_data();
+            }
+            if ( !queued ) break;
+        }
+    }
+    return produced;
+}
@@ -0,0 +1,158 @@
+#ifndef __FM_RTL_H__
+#define __FM_RTL_H__
+
+#include <stdint.h>
+#include <vector>
+
+// -------------------------------------------------------
+// Cycle-approximate model of imp/sv/fm_radio_top.sv.
+//
+// Every RTL module is a stage with the latency of its
+// register chain and a fixed occupancy per accepted input;
+// stages are joined by bounded FIFOs. One step() is one
+// clock: a stage retires its oldest result when it is due
+// and every output FIFO has room (else it stalls), and takes
+// a new input when all its input FIFOs hold one and it is
+// not busy. A value pushed into a FIFO is visible the next
+// clock, so every link adds one register stage. Sample
+// values are bit-true with the RTL, which computes the same
+// Q10 arithmetic as fm_radio.cpp.
+//
+//   fir          TAPS, DECIM; latency 2 (products, adder
+//                tree). With macs < TAPS an output costs
+//                ceil(TAPS / macs) cycles instead of one.
+//   demodulate   latency 40 (cross products 2, prep 1,
+//                32-stage divider, 6 register stages)
+//   multiply     latency 1
+//   add_sub      latency 2 (incl. the stage 6.5 register)
+//   deemphasis   latency 3
+//   gain         latency 1
+//
+// The RTL aligns the L-R operand with the carrier and L+R
+// with L-R through fixed delay lines (3 and 6 registers); in
+// the model these are the FIFOs in front of the joins, so
+// their high-water marks give the depth the alignment needs.
+// -------------------------------------------------------
+
+#define RTL_MAX_IN      2
+#define RTL_MAX_OUT     3
+#define RTL_FIFO_DEPTH  8       // default depth of every link
+
+class RtlFifo
+{
+public:
+    RtlFifo( const char *name, int depth );
+
+    int has_room() const { return count < depth; }
+    int has_data() const { return count > 0; }
+    void push( int v );
+    int pop();
+
+    const char *name;
+    int depth;
+    int count;
+    int high_water;
+    long full_cycles;       // cycles a producer found it full
+
+private:
+    std::vector<int> buf;
+    int head;
+};
+
+
+class RtlStage
+{
+public:
+    RtlStage( const char *name, int latency );
+    virtual ~RtlStage() {}
+
+    // out value sel of each result goes to f
+    void input( RtlFifo *f );
+    void output( RtlFifo *f, int sel = 0 );
+
+    // one clock
+    void step( long cycle );
+
+    int idle() const { return in_flight == 0; }
+
+    const char *name;
+    int latency;
+
+    long accepted;          // inputs taken
+    long produced;          // results pushed
+    long busy_cycles;       // cycles occupied by an input
+    long stall_cycles;      // result due but an output FIFO full
+    long starve_cycles;     // free, but an input FIFO empty
+
+protected:
+    // Consumes one input token x; returns 1 with the result in y when the
+    // input produces an output, else 0. *cost is the occupancy in cycles.
+    virtual int compute( const int *x, int *y, int *cost ) = 0;
+
+private:
+    struct result
+    {
+        long ready;
+        int y[2];
+    };
+
+    RtlFifo *in[RTL_MAX_IN];
+    RtlFifo *out[RTL_MAX_OUT];
+    int out_sel[RTL_MAX_OUT];
+    int n_in, n_out;
+
+    std::vector<result> pipe;   // results in flight, oldest first (ring)
+    int head, in_flight;
+    long busy_until;
+};
+
+
+struct rtl_config
+{
+    int cycles_per_sample;  // clocks between input samples (1 = back to back)
+    int fir_macs;           // multipliers per FIR, 0 = one per tap (the RTL)
+    int fifo_depth;
+};
+
+class FmRtlModel
+{
+public:
+    FmRtlModel( const rtl_config *cfg );
+    ~FmRtlModel();
+
+    // Runs n I/Q samples (already unpacked by read_IQ) through the model until
+    // it drains; left / right receive the audio (n / AUDIO_DECIM samples).
+    // Returns the number of audio samples produced.
+    long run( const int *I, const int *Q, long n, int *left, int *right );
+
+    long cycles() const { return cycle; }
+    long first_output() const { return first_out; }
+    long last_output() const { return last_out; }
+    long source_stalls() const { return src_stalls; }
+    long max_input_delay() const { return src_max_delay; }
+
+    int n_stages() const { return (int)stages.size(); }
+    const RtlStage *stage( int k ) const { return stages[k]; }
+    int n_fifos() const { return (int)fifos.size(); }
+    const RtlFifo *fifo( int k ) const { return fifos[k]; }
+
+private:
+    FmRtlModel( const FmRtlModel & );
+    FmRtlModel & operator=( const FmRtlModel & );
+
+    RtlFifo *link( const char *name );
+
+    rtl_config cfg;
+    std::vector<RtlStage *> stages;     // in pipeline order
+    std::vector<RtlFifo *> fifos;
+
+    RtlFifo *in_I, *in_Q, *out_L, *out_R;
+
+    long cycle;
+    long first_out;
+    long last_out;
+    long src_stalls;        // cycles the input FIFO could not take a due sample
+    long src_max_delay;     // worst lateness of an input sample, cycles
+};
+
+#endif
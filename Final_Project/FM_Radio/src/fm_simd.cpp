@@ -0,0 +1,1013 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "fm_radio.h"
+#include "fm_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FM_X86 1
+#include <immintrin.h>
+#define FM_AVX2  __attribute__((target("avx2")))
+#define FM_SSE41 __attribute__((target("sse4.1")))
+#endif
+
+// -1 until the first simd_get(); atomic because receivers on different
+// threads may make that first call at the same time
+static std::atomic<int> simd_active( -1 );
+
+
+simd_level simd_detect()
+{
+#ifdef FM_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+    {
+        return SIMD_AVX2;
+    }
+    if ( __builtin_cpu_supports("sse4.1") )
+    {
+        return SIMD_SSE41;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+simd_level simd_get()
+{
+    int active = simd_active.load( std::memory_order_acquire );
+
+    if ( active < 0 )
+    {
+        const simd_level best = simd_detect();
+        simd_level level = best;
+        const char *env = getenv("FM_SIMD");
+
+        if ( env != NULL )
+        {
+            if ( strcmp(env, "scalar") == 0 )      level = SIMD_SCALAR;
+            else if ( strcmp(env, "sse4.1") == 0 ) level = SIMD_SSE41;
+            else if ( strcmp(env, "avx2") == 0 )   level = SIMD_AVX2;
+        }
+
+        // the first caller wins; a racing simd_set() is not overwritten
+        const int wanted = (level > best) ? best : level;
+        if ( simd_active.compare_exchange_strong( active, wanted, std::memory_order_acq_rel ) )
+        {
+            active = wanted;
+        }
+    }
+
+    return (simd_level)active;
+}
+
+simd_level simd_set( simd_level level )
+{
+    simd_level best = simd_detect();
+
+    const simd_level active = (level > best) ? best : level;
+
+    simd_active.store( active, std::memory_order_release );
+
+    return active;
+}
+
+const char *simd_name( simd_level level )
+{
+    switch ( level )
+    {
+        case SIMD_AVX2:  return "avx2";
+        case SIMD_SSE41: return "sse4.1";
+        default:         return "scalar";
+    }
+}
+
+
+// -------------------------------------------------------
+// scalar kernels (also used for the tails of the SIMD loops)
+// -------------------------------------------------------
+
+static void fir_block_scalar( const int *src, const int n_out, const int *h, const int taps, const int decimation, int *y )
+{
+    int i = 0;
+    int m = 0;
+
+    for ( i = 0; i < n_out; i++ )
+    {
+        const int *x = &src[i*decimation];
+        int acc = 0;
+
+        for ( m = 0; m < taps; m++ )
+        {
+            acc += DEQUANTIZE( h[m] * x[m] );
+        }
+
+        y[i] = acc;
+    }
+}
+
+static void fir_block_folded_scalar( const int *src, const int n_out, const int *h, const int taps, const int decimation, const int preadd, int *y )
+{
+    int i = 0;
+    int m = 0;
+    const int half = taps / 2;
+
+    for ( i = 0; i < n_out; i++ )
+    {
+        const int *x = &src[i*decimation];
+        int acc = 0;
+
+        if ( preadd )
+        {
+            for ( m = 0; m < half; m++ )
+            {
+                acc += DEQUANTIZE( h[m] * (x[m] + x[taps-m-1]) );
+            }
+        }
+        else
+        {
+            for ( m = 0; m < half; m++ )
+            {
+                acc += DEQUANTIZE( h[m] * x[m] ) + DEQUANTIZE( h[m] * x[taps-m-1] );
+            }
+        }
+
+        if ( taps & 1 )
+        {
+            acc += DEQUANTIZE( h[half] * x[half] );
+        }
+
+        y[i] = acc;
+    }
+}
+
+static void fir_dual_block_scalar( const int *src_a, const int *src_b, const int n_out, const int *h, const int taps, const int decimation,
+                                   int *y_a, int *y_b )
+{
+    int i = 0;
+    int m = 0;
+
+    for ( i = 0; i < n_out; i++ )
+    {
+        const int *a = &src_a[i*decimation];
+        const int *b = &src_b[i*decimation];
+        int acc_a = 0;
+        int acc_b = 0;
+
+        for ( m = 0; m < taps; m++ )
+        {
+            acc_a += DEQUANTIZE( h[m] * a[m] );
+            acc_b += DEQUANTIZE( h[m] * b[m] );
+        }
+
+        y_a[i] = acc_a;
+        y_b[i] = acc_b;
+    }
+}
+
+static void fir_cmplx_block_scalar( const int *src_real, const int *src_imag, const int n_out, const int *h_real, const int *h_imag,
+                                    const int taps, const int decimation, int *y_real, int *y_imag )
+{
+    int i = 0;
+    int m = 0;
+
+    for ( i = 0; i < n_out; i++ )
+    {
+        const int *xr = &src_real[i*decimation];
+        const int *xi = &src_imag[i*decimation];
+        int acc_real = 0;
+        int acc_imag = 0;
+
+        for ( m = 0; m < taps; m++ )
+        {
+            acc_real += DEQUANTIZE((h_real[m] * xr[m]) - (h_imag[m] * xi[m]));
+            acc_imag += DEQUANTIZE((h_real[m] * xi[m]) - (h_imag[m] * xr[m]));
+        }
+
+        y_real[i] = acc_real;
+        y_imag[i] = acc_imag;
+    }
+}
+
+static void iq_unpack_scalar( const uint8_t *iq, const int n, int *I, int *Q )
+{
+    int i = 0;
+    for ( i = 0; i < n; i++ )
+    {
+        I[i] = QUANTIZE_I((short)(iq[i*4+1] << 8) | (short)iq[i*4+0]);
+        Q[i] = QUANTIZE_I((short)(iq[i*4+3] << 8) | (short)iq[i*4+2]);
+    }
+}
+
+static short saturate_s16( int x )
+{
+    return (short)((x > 32767) ? 32767 : (x < -32768) ? -32768 : x);
+}
+
+static void stereo_out_scalar( const int *lpr, const int *lmr, const int n, const int *x_coeffs, const int *y_coeffs,
+                               int *x_l, int *y_l, int *x_r, int *y_r, const int gain, int *left, int *right, short *pcm )
+{
+    int xl = x_l[0], xl_1 = x_l[1], wl = y_l[0], wl_1 = y_l[1];
+    int xr = x_r[0], xr_1 = x_r[1], wr = y_r[0], wr_1 = y_r[1];
+    int i = 0;
+
+    for ( i = 0; i < n; i++ )
+    {
+        const int l = lpr[i] + lmr[i];
+        const int r = lpr[i] - lmr[i];
+
+        // iir() emits the previous feedback state, then advances it
+        const int out_l = DEQUANTIZE(wl * gain) << (14-BITS);
+        const int out_r = DEQUANTIZE(wr * gain) << (14-BITS);
+
+        xl_1 = xl; wl_1 = wl;
+        wl = DEQUANTIZE(x_coeffs[1] * xl) + DEQUANTIZE(x_coeffs[0] * l) + DEQUANTIZE(y_coeffs[0] * wl) + DEQUANTIZE(y_coeffs[1] * wl);
+        xl = l;
+
+        xr_1 = xr; wr_1 = wr;
+        wr = DEQUANTIZE(x_coeffs[1] * xr) + DEQUANTIZE(x_coeffs[0] * r) + DEQUANTIZE(y_coeffs[0] * wr) + DEQUANTIZE(y_coeffs[1] * wr);
+        xr = r;
+
+        if ( left != NULL )
+        {
+            left[i]  = out_l;
+            right[i] = out_r;
+        }
+        if ( pcm != NULL )
+        {
+            pcm[2*i+0] = saturate_s16( out_l );
+            pcm[2*i+1] = saturate_s16( out_r );
+        }
+    }
+
+    x_l[0] = xl; x_l[1] = xl_1; y_l[0] = wl; y_l[1] = wl_1;
+    x_r[0] = xr; x_r[1] = xr_1; y_r[0] = wr; y_r[1] = wr_1;
+}
+
+// -------------------------------------------------------
+// division-free qarctan
+// -------------------------------------------------------
+
+// 1 / m at the midpoint of each of the QDIV_TABLE mantissa intervals of [1, 2)
+struct qdiv_table
+{
+    float rcp[QDIV_TABLE];
+
+    qdiv_table()
+    {
+        for ( int i = 0; i < QDIV_TABLE; i++ )
+        {
+            rcp[i] = (float)(1.0 / (1.0 + (i + 0.5) / QDIV_TABLE));
+        }
+    }
+};
+
+static const float *qdiv_rcp_table()
+{
+    static const qdiv_table table;
+    return table.rcp;
+}
+
+int qdiv_rcp( int num, int d )
+{
+    const float *table = qdiv_rcp_table();
+    const float df = (float)d;
+    unsigned int bits = 0;
+    unsigned int scale_bits = 0;
+    float scale = 0.0f;
+
+    // d = m * 2^e: the top mantissa bits pick 1/m, 2^-e comes from the exponent
+    memcpy( &bits, &df, sizeof(bits) );
+    scale_bits = (254u - (bits >> 23)) << 23;
+    memcpy( &scale, &scale_bits, sizeof(scale) );
+
+    const float rcp = table[(bits >> (23 - QDIV_BITS)) & (QDIV_TABLE - 1)] * scale;
+    const unsigned int a = (num < 0) ? 0u - (unsigned int)num : (unsigned int)num;
+    int q = (int)(fabsf( (float)num ) * rcp);
+
+    // the estimate is within +-1; the remainder (exact mod 2^32) tells which way
+    const int rem = (int)(a - (unsigned int)q * (unsigned int)d);
+    if ( rem < 0 )       q--;
+    else if ( rem >= d ) q++;
+
+    return (num < 0) ? -q : q;
+}
+
+int qarctan_rcp( int y, int x )
+{
+    const int quad1 = QUANTIZE_F(PI / 4.0);
+    const int quad3 = QUANTIZE_F(3.0 * PI / 4.0);
+
+    int abs_y = abs(y) + 1;
+    int angle = 0;
+    int r = 0;
+
+    if ( x >= 0 )
+    {
+        r = qdiv_rcp( (int)((unsigned int)(x - abs_y) << BITS), x + abs_y );
+        angle = quad1 - DEQUANTIZE(quad1 * r);
+    }
+    else
+    {
+        r = qdiv_rcp( (int)((unsigned int)(x + abs_y) << BITS), abs_y - x );
+        angle = quad3 - DEQUANTIZE(quad1 * r);
+    }
+
+    return ((y < 0) ? -angle : angle);
+}
+
+static void demod_block_scalar( const int *real, const int *imag, const int n, int real_prev, int imag_prev,
+                                const int gain, int *out )
+{
+    int i = 0;
+
+    for ( i = 0; i < n; i++ )
+    {
+        // k * atan(c1 * conj(c0)), as in demodulate()
+        int r = DEQUANTIZE(real_prev * real[i]) - DEQUANTIZE(-imag_prev * imag[i]);
+        int q = DEQUANTIZE(real_prev * imag[i]) + DEQUANTIZE(-imag_prev * real[i]);
+
+        // a scalar integer divide beats the table lookup, keep qarctan()
+        out[i] = DEQUANTIZE(gain * qarctan(q, r));
+
+        real_prev = real[i];
+        imag_prev = imag[i];
+    }
+}
+
+
+#ifdef FM_X86
+
+// -------------------------------------------------------
+// AVX2 kernels
+//
+// DEQUANTIZE truncates toward zero, an arithmetic shift rounds
+// toward -inf. Adding (QUANT_VAL-1) to negative products first
+// makes the shift match the C division exactly:
+//   bias = (p >> 31) >>> (32-BITS)   // 1023 if p < 0, else 0
+//   DEQUANTIZE(p) = (p + bias) >> BITS
+// -------------------------------------------------------
+
+FM_AVX2 static inline __m256i deq_avx2( __m256i p )
+{
+    __m256i bias = _mm256_srli_epi32( _mm256_srai_epi32(p, 31), 32 - BITS );
+    return _mm256_srai_epi32( _mm256_add_epi32(p, bias), BITS );
+}
+
+FM_AVX2 static inline int hsum_avx2( __m256i v )
+{
+    __m128i s = _mm_add_epi32( _mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)) );
+    return _mm_cvtsi128_si32( s );
+}
+
+FM_AVX2 static void fir_block_avx2( const int *src, const int n_out, const int *h, const int taps, const int decimation, int *y )
+{
+    int i = 0;
+    int m = 0;
+
+    if ( decimation == 1 )
+    {
+        // 16 consecutive outputs per pass, one broadcast coefficient per tap
+        for ( ; i + 16 <= n_out; i += 16 )
+        {
+            __m256i acc0 = _mm256_setzero_si256();
+            __m256i acc1 = _mm256_setzero_si256();
+
+            for ( m = 0; m < taps; m++ )
+            {
+                __m256i hm = _mm256_set1_epi32( h[m] );
+                __m256i x0 = _mm256_loadu_si256( (const __m256i *)&src[i + m] );
+                __m256i x1 = _mm256_loadu_si256( (const __m256i *)&src[i + m + 8] );
+                acc0 = _mm256_add_epi32( acc0, deq_avx2(_mm256_mullo_epi32(hm, x0)) );
+                acc1 = _mm256_add_epi32( acc1, deq_avx2(_mm256_mullo_epi32(hm, x1)) );
+            }
+
+            _mm256_storeu_si256( (__m256i *)&y[i], acc0 );
+            _mm256_storeu_si256( (__m256i *)&y[i + 8], acc1 );
+        }
+
+        for ( ; i + 8 <= n_out; i += 8 )
+        {
+            __m256i acc = _mm256_setzero_si256();
+
+            for ( m = 0; m < taps; m++ )
+            {
+                __m256i x = _mm256_loadu_si256( (const __m256i *)&src[i + m] );
+                acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(_mm256_set1_epi32(h[m]), x)) );
+            }
+
+            _mm256_storeu_si256( (__m256i *)&y[i], acc );
+        }
+    }
+    else
+    {
+        // decimating: vectorize along the taps of each output
+        const int taps8 = taps & ~7;
+
+        for ( ; i < n_out; i++ )
+        {
+            const int *x = &src[i*decimation];
+            __m256i acc = _mm256_setzero_si256();
+            int tail = 0;
+
+            for ( m = 0; m < taps8; m += 8 )
+            {
+                __m256i hm = _mm256_loadu_si256( (const __m256i *)&h[m] );
+                __m256i xm = _mm256_loadu_si256( (const __m256i *)&x[m] );
+                acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, xm)) );
+            }
+
+            for ( ; m < taps; m++ )
+            {
+                tail += DEQUANTIZE( h[m] * x[m] );
+            }
+
+            y[i] = hsum_avx2( acc ) + tail;
+        }
+    }
+
+    fir_block_scalar( &src[i*decimation], n_out - i, h, taps, decimation, &y[i] );
+}
+
+FM_AVX2 static void fir_block_folded_avx2( const int *src, const int n_out, const int *h, const int taps, const int decimation, const int preadd, int *y )
+{
+    int i = 0;
+    int m = 0;
+    const int half = taps / 2;
+
+    if ( decimation == 1 )
+    {
+        for ( ; i + 8 <= n_out; i += 8 )
+        {
+            __m256i acc = _mm256_setzero_si256();
+
+            for ( m = 0; m < half; m++ )
+            {
+                __m256i hm = _mm256_set1_epi32( h[m] );
+                __m256i a  = _mm256_loadu_si256( (const __m256i *)&src[i + m] );
+                __m256i b  = _mm256_loadu_si256( (const __m256i *)&src[i + taps - m - 1] );
+
+                if ( preadd )
+                {
+                    acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, _mm256_add_epi32(a, b))) );
+                }
+                else
+                {
+                    acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, a)) );
+                    acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, b)) );
+                }
+            }
+
+            if ( taps & 1 )
+            {
+                __m256i x = _mm256_loadu_si256( (const __m256i *)&src[i + half] );
+                acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(_mm256_set1_epi32(h[half]), x)) );
+            }
+
+            _mm256_storeu_si256( (__m256i *)&y[i], acc );
+        }
+    }
+    else
+    {
+        // along the taps: the mirrored half is loaded and lane-reversed
+        const __m256i rev = _mm256_setr_epi32( 7, 6, 5, 4, 3, 2, 1, 0 );
+        const int half8 = half & ~7;
+
+        for ( ; i < n_out; i++ )
+        {
+            const int *x = &src[i*decimation];
+            __m256i acc = _mm256_setzero_si256();
+            int tail = 0;
+
+            for ( m = 0; m < half8; m += 8 )
+            {
+                __m256i hm = _mm256_loadu_si256( (const __m256i *)&h[m] );
+                __m256i a  = _mm256_loadu_si256( (const __m256i *)&x[m] );
+                __m256i b  = _mm256_permutevar8x32_epi32( _mm256_loadu_si256((const __m256i *)&x[taps - m - 8]), rev );
+
+                if ( preadd )
+                {
+                    acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, _mm256_add_epi32(a, b))) );
+                }
+                else
+                {
+                    acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, a)) );
+                    acc = _mm256_add_epi32( acc, deq_avx2(_mm256_mullo_epi32(hm, b)) );
+                }
+            }
+
+            for ( ; m < half; m++ )
+            {
+                tail += preadd ? DEQUANTIZE( h[m] * (x[m] + x[taps-m-1]) )
+                               : DEQUANTIZE( h[m] * x[m] ) + DEQUANTIZE( h[m] * x[taps-m-1] );
+            }
+
+            if ( taps & 1 )
+            {
+                tail += DEQUANTIZE( h[half] * x[half] );
+            }
+
+            y[i] = hsum_avx2( acc ) + tail;
+        }
+    }
+
+    fir_block_folded_scalar( &src[i*decimation], n_out - i, h, taps, decimation, preadd, &y[i] );
+}
+
+FM_AVX2 static void fir_dual_block_avx2( const int *src_a, const int *src_b, const int n_out, const int *h, const int taps, const int decimation,
+                                         int *y_a, int *y_b )
+{
+    int i = 0;
+    int m = 0;
+
+    if ( decimation != 1 )
+    {
+        fir_block_avx2( src_a, n_out, h, taps, decimation, y_a );
+        fir_block_avx2( src_b, n_out, h, taps, decimation, y_b );
+        return;
+    }
+
+    // both rails share the coefficient broadcast
+    for ( ; i + 8 <= n_out; i += 8 )
+    {
+        __m256i acc_a = _mm256_setzero_si256();
+        __m256i acc_b = _mm256_setzero_si256();
+
+        for ( m = 0; m < taps; m++ )
+        {
+            __m256i hm = _mm256_set1_epi32( h[m] );
+            __m256i a  = _mm256_loadu_si256( (const __m256i *)&src_a[i + m] );
+            __m256i b  = _mm256_loadu_si256( (const __m256i *)&src_b[i + m] );
+            acc_a = _mm256_add_epi32( acc_a, deq_avx2(_mm256_mullo_epi32(hm, a)) );
+            acc_b = _mm256_add_epi32( acc_b, deq_avx2(_mm256_mullo_epi32(hm, b)) );
+        }
+
+        _mm256_storeu_si256( (__m256i *)&y_a[i], acc_a );
+        _mm256_storeu_si256( (__m256i *)&y_b[i], acc_b );
+    }
+
+    fir_dual_block_scalar( &src_a[i], &src_b[i], n_out - i, h, taps, decimation, &y_a[i], &y_b[i] );
+}
+
+FM_AVX2 static void fir_cmplx_block_avx2( const int *src_real, const int *src_imag, const int n_out, const int *h_real, const int *h_imag,
+                                          const int taps, const int decimation, int *y_real, int *y_imag )
+{
+    int i = 0;
+    int m = 0;
+
+    if ( decimation == 1 )
+    {
+        for ( ; i + 8 <= n_out; i += 8 )
+        {
+            __m256i acc_real = _mm256_setzero_si256();
+            __m256i acc_imag = _mm256_setzero_si256();
+
+            for ( m = 0; m < taps; m++ )
+            {
+                __m256i hr = _mm256_set1_epi32( h_real[m] );
+                __m256i hi = _mm256_set1_epi32( h_imag[m] );
+                __m256i xr = _mm256_loadu_si256( (const __m256i *)&src_real[i + m] );
+                __m256i xi = _mm256_loadu_si256( (const __m256i *)&src_imag[i + m] );
+                __m256i pr = _mm256_sub_epi32( _mm256_mullo_epi32(hr, xr), _mm256_mullo_epi32(hi, xi) );
+                __m256i pi = _mm256_sub_epi32( _mm256_mullo_epi32(hr, xi), _mm256_mullo_epi32(hi, xr) );
+                acc_real = _mm256_add_epi32( acc_real, deq_avx2(pr) );
+                acc_imag = _mm256_add_epi32( acc_imag, deq_avx2(pi) );
+            }
+
+            _mm256_storeu_si256( (__m256i *)&y_real[i], acc_real );
+            _mm256_storeu_si256( (__m256i *)&y_imag[i], acc_imag );
+        }
+    }
+
+    fir_cmplx_block_scalar( &src_real[i*decimation], &src_imag[i*decimation], n_out - i, h_real, h_imag,
+                            taps, decimation, &y_real[i], &y_imag[i] );
+}
+
+
+// iq_unpack_scalar() on 8 pairs at a time
+FM_AVX2 static void iq_unpack_avx2( const uint8_t *iq, const int n, int *I, int *Q )
+{
+    int i = 0;
+
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        // lane = Q << 16 | I; sign-extend each half and scale by QUANT_VAL
+        const __m256i w = _mm256_loadu_si256( (const __m256i *)&iq[i*4] );
+        _mm256_storeu_si256( (__m256i *)&I[i], _mm256_slli_epi32(_mm256_srai_epi32(_mm256_slli_epi32(w, 16), 16), BITS) );
+        _mm256_storeu_si256( (__m256i *)&Q[i], _mm256_slli_epi32(_mm256_srai_epi32(w, 16), BITS) );
+    }
+
+    iq_unpack_scalar( &iq[i*4], n - i, &I[i], &Q[i] );
+}
+
+// qdiv_rcp() on 8 lanes
+FM_AVX2 static inline __m256i qdiv_avx2( __m256i num, __m256i d, const float *table )
+{
+    const __m256i bits = _mm256_castps_si256( _mm256_cvtepi32_ps(d) );
+    const __m256i idx = _mm256_and_si256( _mm256_srli_epi32(bits, 23 - QDIV_BITS), _mm256_set1_epi32(QDIV_TABLE - 1) );
+    const __m256 scale = _mm256_castsi256_ps( _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(254), _mm256_srli_epi32(bits, 23)), 23) );
+    const __m256 rcp = _mm256_mul_ps( _mm256_i32gather_ps(table, idx, 4), scale );
+
+    const __m256 af = _mm256_andnot_ps( _mm256_set1_ps(-0.0f), _mm256_cvtepi32_ps(num) );
+    __m256i q = _mm256_cvttps_epi32( _mm256_mul_ps(af, rcp) );
+
+    const __m256i rem = _mm256_sub_epi32( _mm256_abs_epi32(num), _mm256_mullo_epi32(q, d) );
+    q = _mm256_add_epi32( q, _mm256_cmpgt_epi32(_mm256_setzero_si256(), rem) );                   // rem < 0: q - 1
+    q = _mm256_sub_epi32( q, _mm256_cmpgt_epi32(rem, _mm256_sub_epi32(d, _mm256_set1_epi32(1))) ); // rem >= d: q + 1
+
+    // num == 0 leaves q == 0, so the zeroing of sign_epi32 is harmless
+    return _mm256_sign_epi32( q, num );
+}
+
+FM_AVX2 static void demod_block_avx2( const int *real, const int *imag, const int n, const int real_prev, const int imag_prev,
+                                      const int gain, int *out )
+{
+    const float *table = qdiv_rcp_table();
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i one   = _mm256_set1_epi32( 1 );
+    const __m256i quad1 = _mm256_set1_epi32( QUANTIZE_F(PI / 4.0) );
+    const __m256i quad3 = _mm256_set1_epi32( QUANTIZE_F(3.0 * PI / 4.0) );
+    const __m256i k     = _mm256_set1_epi32( gain );
+    int i = 0;
+
+    if ( n <= 0 )
+    {
+        return;
+    }
+
+    // sample 0 needs the carried predecessor, every later one reads x[i-1]
+    demod_block_scalar( real, imag, 1, real_prev, imag_prev, gain, out );
+    i = 1;
+
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        const __m256i xr = _mm256_loadu_si256( (const __m256i *)&real[i] );
+        const __m256i xi = _mm256_loadu_si256( (const __m256i *)&imag[i] );
+        const __m256i pr = _mm256_loadu_si256( (const __m256i *)&real[i - 1] );
+        const __m256i pi = _mm256_sub_epi32( zero, _mm256_loadu_si256((const __m256i *)&imag[i - 1]) );
+
+        // c1 * conj(c0)
+        const __m256i x = _mm256_sub_epi32( deq_avx2(_mm256_mullo_epi32(pr, xr)), deq_avx2(_mm256_mullo_epi32(pi, xi)) );
+        const __m256i y = _mm256_add_epi32( deq_avx2(_mm256_mullo_epi32(pr, xi)), deq_avx2(_mm256_mullo_epi32(pi, xr)) );
+
+        // qarctan(y, x)
+        const __m256i abs_y = _mm256_add_epi32( _mm256_abs_epi32(y), one );
+        const __m256i x_neg = _mm256_cmpgt_epi32( zero, x );
+        const __m256i num = _mm256_slli_epi32( _mm256_blendv_epi8(_mm256_sub_epi32(x, abs_y), _mm256_add_epi32(x, abs_y), x_neg), BITS );
+        const __m256i den = _mm256_blendv_epi8( _mm256_add_epi32(x, abs_y), _mm256_sub_epi32(abs_y, x), x_neg );
+        const __m256i r = qdiv_avx2( num, den, table );
+
+        __m256i angle = _mm256_sub_epi32( _mm256_blendv_epi8(quad1, quad3, x_neg), deq_avx2(_mm256_mullo_epi32(quad1, r)) );
+        angle = _mm256_blendv_epi8( angle, _mm256_sub_epi32(zero, angle), _mm256_cmpgt_epi32(zero, y) );
+
+        _mm256_storeu_si256( (__m256i *)&out[i], deq_avx2(_mm256_mullo_epi32(k, angle)) );
+    }
+
+    demod_block_scalar( &real[i], &imag[i], n - i, real[i - 1], imag[i - 1], gain, &out[i] );
+}
+
+// -------------------------------------------------------
+// SSE4.1 kernels (same structure, 4 lanes)
+// -------------------------------------------------------
+
+FM_SSE41 static inline __m128i deq_sse41( __m128i p )
+{
+    __m128i bias = _mm_srli_epi32( _mm_srai_epi32(p, 31), 32 - BITS );
+    return _mm_srai_epi32( _mm_add_epi32(p, bias), BITS );
+}
+
+FM_SSE41 static inline int hsum_sse41( __m128i s )
+{
+    s = _mm_add_epi32( s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)) );
+    return _mm_cvtsi128_si32( s );
+}
+
+FM_SSE41 static void iq_unpack_sse41( const uint8_t *iq, const int n, int *I, int *Q )
+{
+    int i = 0;
+
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        const __m128i w = _mm_loadu_si128( (const __m128i *)&iq[i*4] );
+        _mm_storeu_si128( (__m128i *)&I[i], _mm_slli_epi32(_mm_srai_epi32(_mm_slli_epi32(w, 16), 16), BITS) );
+        _mm_storeu_si128( (__m128i *)&Q[i], _mm_slli_epi32(_mm_srai_epi32(w, 16), BITS) );
+    }
+
+    iq_unpack_scalar( &iq[i*4], n - i, &I[i], &Q[i] );
+}
+
+FM_SSE41 static void stereo_out_sse41( const int *lpr, const int *lmr, const int n, const int *x_coeffs, const int *y_coeffs,
+                                       int *x_l, int *y_l, int *x_r, int *y_r, const int gain, int *left, int *right, short *pcm )
+{
+    // lane 0 = left, lane 1 = right
+    const __m128i sign = _mm_set_epi32( 1, 1, -1, 1 );
+    const __m128i bx0 = _mm_set1_epi32( x_coeffs[0] );
+    const __m128i bx1 = _mm_set1_epi32( x_coeffs[1] );
+    const __m128i by0 = _mm_set1_epi32( y_coeffs[0] );
+    const __m128i by1 = _mm_set1_epi32( y_coeffs[1] );
+    const __m128i k   = _mm_set1_epi32( gain );
+    __m128i x   = _mm_set_epi32( 0, 0, x_r[0], x_l[0] );
+    __m128i x_1 = _mm_set_epi32( 0, 0, x_r[1], x_l[1] );
+    __m128i w   = _mm_set_epi32( 0, 0, y_r[0], y_l[0] );
+    __m128i w_1 = _mm_set_epi32( 0, 0, y_r[1], y_l[1] );
+    int i = 0;
+
+    for ( i = 0; i < n; i++ )
+    {
+        // (lpr + lmr, lpr - lmr)
+        const __m128i v = _mm_add_epi32( _mm_set1_epi32(lpr[i]), _mm_sign_epi32(_mm_set1_epi32(lmr[i]), sign) );
+        const __m128i out = _mm_slli_epi32( deq_sse41(_mm_mullo_epi32(w, k)), 14 - BITS );
+
+        x_1 = x; w_1 = w;
+        w = _mm_add_epi32( _mm_add_epi32(deq_sse41(_mm_mullo_epi32(bx1, x)), deq_sse41(_mm_mullo_epi32(bx0, v))),
+                           _mm_add_epi32(deq_sse41(_mm_mullo_epi32(by0, w)), deq_sse41(_mm_mullo_epi32(by1, w))) );
+        x = v;
+
+        if ( left != NULL )
+        {
+            left[i]  = _mm_cvtsi128_si32( out );
+            right[i] = _mm_extract_epi32( out, 1 );
+        }
+        if ( pcm != NULL )
+        {
+            // saturating pack leaves the frame (L, R) in the low 32 bits
+            const int frame = _mm_cvtsi128_si32( _mm_packs_epi32(out, out) );
+            memcpy( &pcm[2*i], &frame, sizeof(frame) );
+        }
+    }
+
+    x_l[0] = _mm_cvtsi128_si32( x );   x_r[0] = _mm_extract_epi32( x, 1 );
+    x_l[1] = _mm_cvtsi128_si32( x_1 ); x_r[1] = _mm_extract_epi32( x_1, 1 );
+    y_l[0] = _mm_cvtsi128_si32( w );   y_r[0] = _mm_extract_epi32( w, 1 );
+    y_l[1] = _mm_cvtsi128_si32( w_1 ); y_r[1] = _mm_extract_epi32( w_1, 1 );
+}
+
+FM_SSE41 static void fir_block_sse41( const int *src, const int n_out, const int *h, const int taps, const int decimation, int *y )
+{
+    int i = 0;
+    int m = 0;
+
+    if ( decimation == 1 )
+    {
+        for ( ; i + 8 <= n_out; i += 8 )
+        {
+            __m128i acc0 = _mm_setzero_si128();
+            __m128i acc1 = _mm_setzero_si128();
+
+            for ( m = 0; m < taps; m++ )
+            {
+                __m128i hm = _mm_set1_epi32( h[m] );
+                __m128i x0 = _mm_loadu_si128( (const __m128i *)&src[i + m] );
+                __m128i x1 = _mm_loadu_si128( (const __m128i *)&src[i + m + 4] );
+                acc0 = _mm_add_epi32( acc0, deq_sse41(_mm_mullo_epi32(hm, x0)) );
+                acc1 = _mm_add_epi32( acc1, deq_sse41(_mm_mullo_epi32(hm, x1)) );
+            }
+
+            _mm_storeu_si128( (__m128i *)&y[i], acc0 );
+            _mm_storeu_si128( (__m128i *)&y[i + 4], acc1 );
+        }
+    }
+    else
+    {
+        const int taps4 = taps & ~3;
+
+        for ( ; i < n_out; i++ )
+        {
+            const int *x = &src[i*decimation];
+            __m128i acc = _mm_setzero_si128();
+            int tail = 0;
+
+            for ( m = 0; m < taps4; m += 4 )
+            {
+                __m128i hm = _mm_loadu_si128( (const __m128i *)&h[m] );
+                __m128i xm = _mm_loadu_si128( (const __m128i *)&x[m] );
+                acc = _mm_add_epi32( acc, deq_sse41(_mm_mullo_epi32(hm, xm)) );
+            }
+
+            for ( ; m < taps; m++ )
+            {
+                tail += DEQUANTIZE( h[m] * x[m] );
+            }
+
+            y[i] = hsum_sse41( acc ) + tail;
+        }
+    }
+
+    fir_block_scalar( &src[i*decimation], n_out - i, h, taps, decimation, &y[i] );
+}
+
+FM_SSE41 static void fir_dual_block_sse41( const int *src_a, const int *src_b, const int n_out, const int *h, const int taps, const int decimation,
+                                           int *y_a, int *y_b )
+{
+    int i = 0;
+    int m = 0;
+
+    if ( decimation != 1 )
+    {
+        fir_block_sse41( src_a, n_out, h, taps, decimation, y_a );
+        fir_block_sse41( src_b, n_out, h, taps, decimation, y_b );
+        return;
+    }
+
+    for ( ; i + 4 <= n_out; i += 4 )
+    {
+        __m128i acc_a = _mm_setzero_si128();
+        __m128i acc_b = _mm_setzero_si128();
+
+        for ( m = 0; m < taps; m++ )
+        {
+            __m128i hm = _mm_set1_epi32( h[m] );
+            __m128i a  = _mm_loadu_si128( (const __m128i *)&src_a[i + m] );
+            __m128i b  = _mm_loadu_si128( (const __m128i *)&src_b[i + m] );
+            acc_a = _mm_add_epi32( acc_a, deq_sse41(_mm_mullo_epi32(hm, a)) );
+            acc_b = _mm_add_epi32( acc_b, deq_sse41(_mm_mullo_epi32(hm, b)) );
+        }
+
+        _mm_storeu_si128( (__m128i *)&y_a[i], acc_a );
+        _mm_storeu_si128( (__m128i *)&y_b[i], acc_b );
+    }
+
+    fir_dual_block_scalar( &src_a[i], &src_b[i], n_out - i, h, taps, decimation, &y_a[i], &y_b[i] );
+}
+
+FM_SSE41 static void fir_cmplx_block_sse41( const int *src_real, const int *src_imag, const int n_out, const int *h_real, const int *h_imag,
+                                            const int taps, const int decimation, int *y_real, int *y_imag )
+{
+    int i = 0;
+    int m = 0;
+
+    if ( decimation == 1 )
+    {
+        for ( ; i + 4 <= n_out; i += 4 )
+        {
+            __m128i acc_real = _mm_setzero_si128();
+            __m128i acc_imag = _mm_setzero_si128();
+
+            for ( m = 0; m < taps; m++ )
+            {
+                __m128i hr = _mm_set1_epi32( h_real[m] );
+                __m128i hi = _mm_set1_epi32( h_imag[m] );
+                __m128i xr = _mm_loadu_si128( (const __m128i *)&src_real[i + m] );
+                __m128i xi = _mm_loadu_si128( (const __m128i *)&src_imag[i + m] );
+                __m128i pr = _mm_sub_epi32( _mm_mullo_epi32(hr, xr), _mm_mullo_epi32(hi, xi) );
+                __m128i pi = _mm_sub_epi32( _mm_mullo_epi32(hr, xi), _mm_mullo_epi32(hi, xr) );
+                acc_real = _mm_add_epi32( acc_real, deq_sse41(pr) );
+                acc_imag = _mm_add_epi32( acc_imag, deq_sse41(pi) );
+            }
+
+            _mm_storeu_si128( (__m128i *)&y_real[i], acc_real );
+            _mm_storeu_si128( (__m128i *)&y_imag[i], acc_imag );
+        }
+    }
+
+    fir_cmplx_block_scalar( &src_real[i*decimation], &src_imag[i*decimation], n_out - i, h_real, h_imag,
+                            taps, decimation, &y_real[i], &y_imag[i] );
+}
+
+#endif // FM_X86
+
+
+// -------------------------------------------------------
+// dispatch
+// -------------------------------------------------------
+
+void fir_block( const int *src, const int n_out, const int *h, const int taps, const int decimation, int *y )
+{
+    if ( n_out <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    switch ( simd_get() )
+    {
+        case SIMD_AVX2:  fir_block_avx2( src, n_out, h, taps, decimation, y ); return;
+        case SIMD_SSE41: fir_block_sse41( src, n_out, h, taps, decimation, y ); return;
+        default: break;
+    }
+#endif
+
+    fir_block_scalar( src, n_out, h, taps, decimation, y );
+}
+
+void fir_block_folded( const int *src, const int n_out, const int *h, const int taps, const int decimation, const int preadd, int *y )
+{
+    if ( n_out <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    if ( simd_get() == SIMD_AVX2 )
+    {
+        fir_block_folded_avx2( src, n_out, h, taps, decimation, preadd, y );
+        return;
+    }
+#endif
+
+    fir_block_folded_scalar( src, n_out, h, taps, decimation, preadd, y );
+}
+
+void fir_dual_block( const int *src_a, const int *src_b, const int n_out, const int *h, const int taps, const int decimation,
+                     int *y_a, int *y_b )
+{
+    if ( n_out <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    switch ( simd_get() )
+    {
+        case SIMD_AVX2:  fir_dual_block_avx2( src_a, src_b, n_out, h, taps, decimation, y_a, y_b ); return;
+        case SIMD_SSE41: fir_dual_block_sse41( src_a, src_b, n_out, h, taps, decimation, y_a, y_b ); return;
+        default: break;
+    }
+#endif
+
+    fir_dual_block_scalar( src_a, src_b, n_out, h, taps, decimation, y_a, y_b );
+}
+
+void fir_cmplx_block( const int *src_real, const int *src_imag, const int n_out, const int *h_real, const int *h_imag,
+                      const int taps, const int decimation, int *y_real, int *y_imag )
+{
+    if ( n_out <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    switch ( simd_get() )
+    {
+        case SIMD_AVX2:  fir_cmplx_block_avx2( src_real, src_imag, n_out, h_real, h_imag, taps, decimation, y_real, y_imag ); return;
+        case SIMD_SSE41: fir_cmplx_block_sse41( src_real, src_imag, n_out, h_real, h_imag, taps, decimation, y_real, y_imag ); return;
+        default: break;
+    }
+#endif
+
+    fir_cmplx_block_scalar( src_real, src_imag, n_out, h_real, h_imag, taps, decimation, y_real, y_imag );
+}
+
+void iq_unpack( const uint8_t *iq, const int n, int *I, int *Q )
+{
+    if ( n <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    switch ( simd_get() )
+    {
+        case SIMD_AVX2:  iq_unpack_avx2( iq, n, I, Q ); return;
+        case SIMD_SSE41: iq_unpack_sse41( iq, n, I, Q ); return;
+        default: break;
+    }
+#endif
+
+    iq_unpack_scalar( iq, n, I, Q );
+}
+
+void stereo_out_block( const int *lpr, const int *lmr, const int n, const int *x_coeffs, const int *y_coeffs,
+                       int *x_l, int *y_l, int *x_r, int *y_r, const int gain, int *left, int *right, short *pcm )
+{
+    if ( n <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    // two lanes do not fill a 256-bit register; AVX2 hosts use the 128-bit kernel
+    if ( simd_get() >= SIMD_SSE41 )
+    {
+        stereo_out_sse41( lpr, lmr, n, x_coeffs, y_coeffs, x_l, y_l, x_r, y_r, gain, left, right, pcm );
+        return;
+    }
+#endif
+
+    stereo_out_scalar( lpr, lmr, n, x_coeffs, y_coeffs, x_l, y_l, x_r, y_r, gain, left, right, pcm );
+}
+
+void demod_block( const int *real, const int *imag, const int n, const int real_prev, const int imag_prev,
+                  const int gain, int *out )
+{
+    if ( n <= 0 )
+    {
+        return;
+    }
+
+#ifdef FM_X86
+    if ( simd_get() == SIMD_AVX2 )
+    {
+        demod_block_avx2( real, imag, n, real_prev, imag_prev, gain, out );
+        return;
+    }
+#endif
+
+    demod_block_scalar( real, imag, n, real_prev, imag_prev, gain, out );
+}
@@ -0,0 +1,107 @@
+#ifndef __FM_SIMD_H__
+#define __FM_SIMD_H__
+
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Vectorized DSP kernels with runtime CPU dispatch.
+//
+// Every kernel reproduces the scalar fixed-point semantics of
+// fm_radio.cpp exactly: each product is DEQUANTIZEd (truncated
+// toward zero) on its own before it is accumulated, so the
+// output is bit-identical to the fm_golden reference.
+//
+// The active level defaults to the best one the CPU supports
+// and can be forced with the FM_SIMD environment variable
+// (scalar, sse4.1, avx2) or with simd_set().
+// -------------------------------------------------------
+
+enum simd_level
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE41  = 1,
+    SIMD_AVX2   = 2
+};
+
+// best level supported by the host CPU
+simd_level simd_detect();
+
+// level currently used by the dispatched kernels
+simd_level simd_get();
+
+// force a level (clamped to what the CPU supports), returns the level in effect
+simd_level simd_set( simd_level level );
+
+const char *simd_name( simd_level level );
+
+// Window-ordered FIR over a contiguous history-prefixed input:
+//   y[i] = sum_m DEQUANTIZE( h[m] * src[i*decimation + m] ),  m = 0..taps-1
+// src[i*decimation + taps-1] is the newest sample of output i.
+void fir_block( const int *src, const int n_out, const int *h, const int taps, const int decimation, int *y );
+
+// Folded window-ordered FIR for symmetric h (h[m] == h[taps-1-m]).
+// preadd = 0: DEQUANTIZE(h[m]*a) + DEQUANTIZE(h[m]*b), bit-exact with fir_block()
+// preadd = 1: DEQUANTIZE(h[m]*(a + b)), one multiply per tap pair
+// Vectorized for AVX2; other levels run the scalar kernel.
+void fir_block_folded( const int *src, const int n_out, const int *h, const int taps, const int decimation, const int preadd, int *y );
+
+// Two real FIRs with the same coefficients in one pass, e.g. the I and Q
+// rails of a complex filter whose coefficients are purely real:
+//   y_a[i] = sum_m DEQUANTIZE( h[m] * src_a[i*decimation + m] ), same for b
+void fir_dual_block( const int *src_a, const int *src_b, const int n_out, const int *h, const int taps, const int decimation,
+                     int *y_a, int *y_b );
+
+// Window-ordered complex FIR with the fir_cmplx() arithmetic:
+//   y_real[i] = sum_m DEQUANTIZE( h_real[m]*x_real[k] - h_imag[m]*x_imag[k] )
+//   y_imag[i] = sum_m DEQUANTIZE( h_real[m]*x_imag[k] - h_imag[m]*x_real[k] ),  k = i*decimation + m
+void fir_cmplx_block( const int *src_real, const int *src_imag, const int n_out, const int *h_real, const int *h_imag,
+                      const int taps, const int decimation, int *y_real, int *y_imag );
+
+// read_IQ(): n interleaved little-endian int16 I/Q pairs (4 bytes each)
+// to Q10 planes, I[i] = QUANTIZE_I(I sample), Q[i] = QUANTIZE_I(Q sample).
+// Each pair is one 32-bit lane (Q << 16 | I), so the vector paths split it
+// with two shifts per plane instead of byte shuffles.
+void iq_unpack( const uint8_t *iq, const int n, int *I, int *Q );
+
+// Tail of the graph for both channels in one pass:
+//   l = lpr + lmr, r = lpr - lmr
+//   first-order iir() (taps = 2) of each with x_coeffs / y_coeffs
+//   out = DEQUANTIZE(deemph * gain) << (14 - BITS)
+// x_* and y_* are the iir() delay lines (only [0] and [1] are used). out is
+// written to left / right as int and / or to pcm as saturated interleaved
+// s16; either may be NULL. Bit-exact with add_n, sub_n, deemphasis_n and
+// gain_n. The recursion is serial in time, so the vector path runs L and R
+// as two lanes of one register.
+void stereo_out_block( const int *lpr, const int *lmr, const int n, const int *x_coeffs, const int *y_coeffs,
+                       int *x_l, int *y_l, int *x_r, int *y_r, const int gain, int *left, int *right, short *pcm );
+
+// -------------------------------------------------------
+// Division-free qarctan()
+//
+// qarctan() divides QUANTIZE_I(x -/+ |y|+1) by d = |x| + |y| + 1
+// once per quad-rate sample. The quotient is taken from a
+// QDIV_TABLE-entry reciprocal table of the normalized d (relative
+// error <= 2^-11), which puts the truncated estimate within +-1
+// of the exact quotient because |quotient| <= 1024; one remainder
+// check then corrects it. Exact for 1 <= d <= 2^23, which covers
+// every conjugate product demodulate() can form (|x|, |y| < 2^22,
+// each a sum of two DEQUANTIZEd int products).
+// -------------------------------------------------------
+
+#define QDIV_BITS   10
+#define QDIV_TABLE  (1 << QDIV_BITS)
+
+// num / d truncated toward zero, for 1 <= d <= 2^23 and |num / d| <= 1024
+int qdiv_rcp( int num, int d );
+
+// qarctan() with qdiv_rcp() in place of the division
+int qarctan_rcp( int y, int x );
+
+// Batch demodulate(): out[i] from the pair (real[i], imag[i]) and its
+// predecessor, where the predecessor of sample 0 is (real_prev, imag_prev).
+// Bit-exact with demodulate(). Vectorized and division-free for AVX2; other
+// levels run the scalar loop with qarctan().
+void demod_block( const int *real, const int *imag, const int n, const int real_prev, const int imag_prev,
+                  const int gain, int *out );
+
+#endif
@@ -0,0 +1,73 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fm_radio.h"
+#include "fm_synth.h"
+
+
+void fm_synth_defaults( fm_synth_params *p )
+{
+    p->left_hz   = 1000.0f;
+    p->right_hz  = 2500.0f;
+    p->left_amp  = 0.5f;
+    p->right_amp = 0.5f;
+    p->pilot_amp = 0.1f;
+    p->iq_amp    = 12000.0f;
+    p->noise_amp = 100.0f;
+    p->seed      = 1;
+}
+
+void fm_synth_stereo( unsigned char *IQ, const long start, const int samples, const fm_synth_params *p )
+{
+    const double w_l     = 2.0 * M_PI * p->left_hz / QUAD_RATE;
+    const double w_r     = 2.0 * M_PI * p->right_hz / QUAD_RATE;
+    const double w_pilot = 2.0 * M_PI * 19000.0 / QUAD_RATE;
+    const double k_dev   = 2.0 * M_PI * MAX_DEV / QUAD_RATE;
+    const double mono    = 0.9 - p->pilot_amp;     // leave headroom for the pilot
+
+    int i = 0;
+
+    for ( i = 0; i < samples; i++ )
+    {
+        const long n = start + i;
+
+        // the instantaneous phase is the integral of the MPX signal; use the
+        // closed-form integral of every tone so any start index continues it
+        double phase = 0.0;
+        phase += 0.5 * mono * p->left_amp  * (1.0 - cos( w_l * n )) / w_l;
+        phase += 0.5 * mono * p->right_amp * (1.0 - cos( w_r * n )) / w_r;
+        phase += p->pilot_amp * (1.0 - cos( w_pilot * n )) / w_pilot;
+
+        // (L-R)/2 * sin(2 w_p n) = products of sines -> difference of cosines
+        phase += 0.25 * mono * p->left_amp  * ( sin((2*w_pilot - w_l) * n) / (2*w_pilot - w_l)
+                                              - sin((2*w_pilot + w_l) * n) / (2*w_pilot + w_l) );
+        phase -= 0.25 * mono * p->right_amp * ( sin((2*w_pilot - w_r) * n) / (2*w_pilot - w_r)
+                                              - sin((2*w_pilot + w_r) * n) / (2*w_pilot + w_r) );
+        phase *= k_dev;
+
+        unsigned int s = p->seed * 2654435761u + (unsigned int)n * 2246822519u;
+        s ^= s >> 15; s *= 2246822519u; s ^= s >> 13;
+        const double noise_i = p->noise_amp * ((double)(s & 0xffff) / 65536.0 - 0.5);
+        const double noise_q = p->noise_amp * ((double)(s >> 16) / 65536.0 - 0.5);
+
+        const short I = (short)lrint( p->iq_amp * cos(phase) + noise_i );
+        const short Q = (short)lrint( p->iq_amp * sin(phase) + noise_q );
+
+        IQ[i*4+0] = (unsigned char)(I & 0xff);
+        IQ[i*4+1] = (unsigned char)((I >> 8) & 0xff);
+        IQ[i*4+2] = (unsigned char)(Q & 0xff);
+        IQ[i*4+3] = (unsigned char)((Q >> 8) & 0xff);
+    }
+}
+
+float fm_synth_left( const fm_synth_params *p, const long n )
+{
+    return p->left_amp * (float)sin( 2.0 * M_PI * p->left_hz * n / AUDIO_RATE );
+}
+
+float fm_synth_right( const fm_synth_params *p, const long n )
+{
+    return p->right_amp * (float)sin( 2.0 * M_PI * p->right_hz * n / AUDIO_RATE );
+}
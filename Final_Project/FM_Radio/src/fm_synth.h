@@ -0,0 +1,33 @@
+#ifndef __FM_SYNTH_H__
+#define __FM_SYNTH_H__
+
+// -------------------------------------------------------
+// Synthetic stereo FM capture in the usrp.dat format
+// (interleaved little-endian int16 I/Q at QUAD_RATE).
+// Left and right are single tones so the decoded audio
+// can be checked against a known reference.
+// -------------------------------------------------------
+
+struct fm_synth_params
+{
+    float left_hz;          // left channel tone
+    float right_hz;         // right channel tone
+    float left_amp;         // tone amplitudes, 1.0 = full deviation share
+    float right_amp;
+    float pilot_amp;        // 19 kHz pilot injection (0.1 = 10%)
+    float iq_amp;           // I/Q magnitude in ADC counts
+    float noise_amp;        // uniform noise added to I and Q, ADC counts
+    unsigned int seed;
+};
+
+void fm_synth_defaults( fm_synth_params *p );
+
+// Generates samples I/Q pairs into IQ (4 bytes per pair), starting at
+// sample index start so that consecutive calls continue the same signal.
+void fm_synth_stereo( unsigned char *IQ, const long start, const int samples, const fm_synth_params *p );
+
+// Reference tones at AUDIO_RATE for audio sample index n.
+float fm_synth_left( const fm_synth_params *p, const long n );
+float fm_synth_right( const fm_synth_params *p, const long n );
+
+#endif
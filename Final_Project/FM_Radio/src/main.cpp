@@ -2,57 +2,213 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <fcntl.h>
-#include <io.h>
 #include <unistd.h>
 
 #include "fm_radio.h"
+#include "fm_pipeline.h"
+#include "fm_input.h"
+#include "fm_output.h"
+#include "fm_prof.h"
 #include "audio.h"
 
 using namespace std;
 
+struct stream_io
+{
+    fm_input *input;
+    FmAudioWriter *writer;
+};
+
+static int file_source( void *arg, uint8_t *iq, int max_samples )
+{
+    stream_io *io = (stream_io *)arg;
+    const uint8_t *block;
+    int n = fm_input_next( io->input, max_samples, &block );
+    memcpy( iq, block, (size_t)n * 4 );
+    return n;
+}
+
+static void audio_sink( void *arg, const int *left, const int *right, int n )
+{
+    stream_io *io = (stream_io *)arg;
+    io->writer->write( left, right, n );
+}
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage()
+{
+    fprintf( stderr, "Usage: fm_radio [-p] [-l] [-b samples] [-w out.wav | -r out.raw | -n] usrp.dat\n" );
+    fprintf( stderr, "  -p  run every stage on its own thread\n" );
+    fprintf( stderr, "  -b  I/Q samples per block (multiple of %d, default %d, %d with -p);\n", AUDIO_DECIM, SAMPLES, FM_PIPE_BLOCK );
+    fprintf( stderr, "      small blocks cut the latency, e.g. 512 = 2 ms at %d Hz\n", QUAD_RATE );
+    fprintf( stderr, "  -l  live input: drop audio instead of pausing when the output falls behind\n" );
+    fprintf( stderr, "  -w  write a 16-bit stereo .wav file instead of playing to /dev/dsp\n" );
+    fprintf( stderr, "  -r  write raw interleaved s16 (\"-\" for stdout)\n" );
+    fprintf( stderr, "  -n  decode as fast as possible and discard the audio\n" );
+}
+
 int main(int argc, char **argv)
 {
-    static unsigned char IQ[SAMPLES*4];
-    static int left_audio[AUDIO_SAMPLES];
-    static int right_audio[AUDIO_SAMPLES];
+    // stage timing report (a no-op unless built with PROFILE=1); first, so
+    // that every thread started later leaves SIGUSR1 to the reporter
+    fm_prof_start( getenv("FM_PROF_JSON") );
+
+    int pipelined = 0;
+    int block = 0;
+    int live = 0;
+    int headless = 0;
+    fm_output_kind out_kind = FM_OUT_NULL;
+    const char *out_path = NULL;
+    const char *in_path = NULL;
 
-    if ( argc < 2 )
+    for ( int i = 1; i < argc; i++ )
     {
-        printf("Missing input file.\n");
+        if ( strcmp(argv[i], "-p") == 0 )
+        {
+            pipelined = 1;
+        }
+        else if ( strcmp(argv[i], "-b") == 0 && i + 1 < argc )
+        {
+            block = atoi( argv[++i] );
+            if ( block < AUDIO_DECIM || block % AUDIO_DECIM != 0 )
+            {
+                fprintf( stderr, "Block size must be a positive multiple of %d.\n", AUDIO_DECIM );
+                return -1;
+            }
+        }
+        else if ( strcmp(argv[i], "-l") == 0 )
+        {
+            live = 1;
+        }
+        else if ( (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-r") == 0) && i + 1 < argc )
+        {
+            headless = 1;
+            out_kind = (argv[i][1] == 'w') ? FM_OUT_WAV : FM_OUT_RAW;
+            out_path = argv[++i];
+        }
+        else if ( strcmp(argv[i], "-n") == 0 )
+        {
+            headless = 1;
+            out_kind = FM_OUT_NULL;
+        }
+        else if ( (argv[i][0] != '-' || argv[i][1] == '\0') && in_path == NULL )
+        {
+            in_path = argv[i];
+        }
+        else
+        {
+            usage();
+            return -1;
+        }
+    }
+
+    if ( in_path == NULL )
+    {
+        fprintf(stderr, "Missing input file.\n");
+        usage();
         return -1;
     }
-    
+
     // initialize the audio output
-    int audio_fd = audio_init( AUDIO_RATE );
-    if ( audio_fd < 0 )
+    fm_output out;
+    if ( headless )
     {
-        printf("Failed to initialize audio!\n");
-        return -1;
+        if ( fm_output_open( &out, out_kind, out_path, AUDIO_RATE ) < 0 )
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        int audio_fd = audio_init( AUDIO_RATE );
+        if ( audio_fd < 0 )
+        {
+            printf("Failed to initialize audio! Use -w, -r or -n without a sound device.\n");
+            return -1;
+        }
+        fm_output_attach( &out, audio_fd, AUDIO_RATE );
     }
 
-    FILE * usrp_file = fopen(argv[1], "rb");
-    if ( usrp_file == NULL )
+    // map the capture; blocks are read straight out of the page cache
+    fm_input usrp_file;
+    if ( fm_input_open( &usrp_file, in_path ) < 0 )
     {
-        printf("Unable to open file.\n");
         return -1;
-    }    
-    
-    // run the FM receiver 
-    while( !feof(usrp_file) )
+    }
+
+    if ( block == 0 )
+    {
+        block = pipelined ? FM_PIPE_BLOCK : SAMPLES;
+    }
+
+    // write() runs on its own thread; a recording can wait for a free
+    // buffer, a live stream cannot and drops the block instead. A writer
+    // slot is handed over only once it is full, so it must not be larger
+    // than one block or it would add latency of its own.
+    const int slot_frames = (block / AUDIO_DECIM < FM_WRITER_FRAMES) ? block / AUDIO_DECIM : FM_WRITER_FRAMES;
+    FmAudioWriter *writer = new FmAudioWriter( &out, live, FM_WRITER_SLOTS, slot_frames );
+
+    stream_io io = { &usrp_file, writer };
+    const double t0 = now_sec();
+
+    if ( pipelined )
     {
-        // get I/Q from data file
-        fread( IQ, sizeof(char), SAMPLES*4, usrp_file );
+        FmPipeline pipeline( block );
+
+        pipeline.run( file_source, &io, audio_sink, &io );
+    }
+    else
+    {
+        // run the FM receiver 
+        FmReceiver receiver( block );
+        const uint8_t *IQ;
+        int n;
+
+        // the last block is usually short: decode only the samples it holds
+        while( (n = fm_input_next( &usrp_file, block, &IQ )) > 0 )
+        {
+            const int whole = n - (n % AUDIO_DECIM);
+            int done = 0;
 
-        // fm radio in mono
-        fm_radio_stereo( IQ, left_audio, right_audio );
+            // fm radio in stereo, decoded straight into the audio buffers
+            while ( done < whole )
+            {
+                int frames;
+                short *pcm = writer->reserve( &frames );
+                const int count = (whole - done < frames * AUDIO_DECIM) ? whole - done : frames * AUDIO_DECIM;
 
-        // write to audio output
-        audio_tx( audio_fd, AUDIO_RATE, left_audio, right_audio, AUDIO_SAMPLES );
+                writer->commit( receiver.process_s16( &IQ[done*4], count, pcm ) );
+                done += count;
+            }
+        }
+    }
+
+    writer->flush();
+
+    // real-time factor: seconds of audio decoded per second of wall time
+    const double elapsed = now_sec() - t0;
+    const double audio_sec = fm_output_seconds( &out );
+    fprintf( stderr, "decoded %.2f s of audio in %.3f s (%.1fx real time)\n", audio_sec, elapsed,
+             (elapsed > 0) ? audio_sec / elapsed : 0.0 );
+    fprintf( stderr, "audio writer: %ld overruns (%ld frames dropped)", writer->overruns(), writer->dropped() );
+    if ( out.realtime )
+    {
+        fprintf( stderr, ", %ld underruns", writer->underruns() );
     }
+    fprintf( stderr, "\n" );
 
-    fclose( usrp_file );
-    close( audio_fd );
+    delete writer;
+    fm_input_close( &usrp_file );
+    fm_output_close( &out );
 
     return 0;
 }
@@ -0,0 +1,1778 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "fm_radio.h"
+#include "fm_simd.h"
+#include "fm_synth.h"
+#include "fm_pipeline.h"
+#include "fm_chunk.h"
+#include "fm_input.h"
+#include "fm_fixed.h"
+
+// -------------------------------------------------------
+// Performance / accuracy reports for the FM DSP kernels.
+//
+//   fm_bench <command> [-i input.dat] [-n samples]
+//   fm_bench kernels [-i input.dat] [-o out.jsonl] [-b baseline.jsonl] [-t tolerance]
+//
+// Without -i a synthetic stereo capture is generated.
+// -------------------------------------------------------
+
+struct bench_opts
+{
+    const char *input;
+    int samples;
+    const char *output;     // kernels: write the results here as well
+    const char *baseline;   // kernels: fail on regressions against this run
+    double tolerance;       // kernels: allowed slowdown, 0.25 = 25 %
+};
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// I/Q capture from file (or synthetic), whole AUDIO_DECIM groups only
+static int load_iq( const bench_opts *o, std::vector<unsigned char> &iq )
+{
+    int samples = o->samples - (o->samples % AUDIO_DECIM);
+
+    iq.assign( (size_t)samples * 4, 0 );
+
+    if ( o->input == NULL )
+    {
+        fm_synth_params p;
+        fm_synth_defaults( &p );
+        fm_synth_stereo( iq.data(), 0, samples, &p );
+        return samples;
+    }
+
+    FILE *f = fopen( o->input, "rb" );
+    if ( f == NULL )
+    {
+        printf( "Cannot open %s\n", o->input );
+        return -1;
+    }
+    size_t n = fread( iq.data(), 4, samples, f );
+    fclose( f );
+
+    samples = (int)(n - (n % AUDIO_DECIM));
+    iq.resize( (size_t)samples * 4 );
+    return samples;
+}
+
+struct err_stats
+{
+    int max_abs;
+    double rms;
+    int mismatches;
+};
+
+static err_stats compare( const int *ref, const int *test, const int n )
+{
+    err_stats e = { 0, 0.0, 0 };
+    double sum_sq = 0.0;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        int d = abs( test[i] - ref[i] );
+        if ( d != 0 ) e.mismatches++;
+        if ( d > e.max_abs ) e.max_abs = d;
+        sum_sq += (double)d * d;
+    }
+    e.rms = (n > 0) ? sqrt( sum_sq / n ) : 0.0;
+    return e;
+}
+
+
+// -------------------------------------------------------
+// fold: deviation and speed of the symmetric FIR variants
+// -------------------------------------------------------
+
+static int bench_fold( const bench_opts *o )
+{
+    static const char *fold_names[] = { "off", "exact", "preadd" };
+
+    struct filter_case { const char *name; const int *coeff; int taps; int decimation; };
+    const filter_case filters[] =
+    {
+        { "audio_lpr", AUDIO_LPR_COEFFS, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM },
+        { "audio_lmr", AUDIO_LMR_COEFFS, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM },
+        { "bp_lmr",    BP_LMR_COEFFS,    BP_LMR_COEFF_TAPS,    1 },
+        { "bp_pilot",  BP_PILOT_COEFFS,  BP_PILOT_COEFF_TAPS,  1 },
+        { "hp",        HP_COEFFS,        HP_COEFF_TAPS,        1 },
+    };
+    const int n_filters = sizeof(filters) / sizeof(filters[0]);
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    // demodulated signal as the common filter input
+    std::vector<int> I(n), Q(n), I_fir(n), Q_fir(n), demod(n), y_ref(n), y(n);
+    int x_real[MAX_TAPS] = {0}, x_imag[MAX_TAPS] = {0};
+    int demod_real[1] = {0}, demod_imag[1] = {0};
+    read_IQ( iq.data(), I.data(), Q.data(), n );
+    fir_cmplx_n( I.data(), Q.data(), n, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, x_real, x_imag,
+                 CHANNEL_COEFF_TAPS, 1, I_fir.data(), Q_fir.data() );
+    demodulate_n( I_fir.data(), Q_fir.data(), demod_real, demod_imag, n, FM_DEMOD_GAIN, demod.data() );
+
+    printf( "simd: %s, samples: %d\n\n", simd_name(simd_get()), n );
+    printf( "%-10s %-7s %5s %9s %10s %10s %12s\n", "filter", "fold", "sym", "max_err", "rms_err", "mismatch", "ns/sample" );
+
+    for ( int k = 0; k < n_filters; k++ )
+    {
+        const filter_case *c = &filters[k];
+        const int n_out = n / c->decimation;
+
+        for ( int mode = FIR_FOLD_OFF; mode <= FIR_FOLD_PREADD; mode++ )
+        {
+            fir_filter f;
+            fir_setup( &f, c->coeff, c->taps, c->decimation, (fir_fold)mode );
+
+            double t0 = now_sec();
+            fir_filter_n( &f, demod.data(), n, (mode == FIR_FOLD_OFF) ? y_ref.data() : y.data() );
+            double dt = now_sec() - t0;
+
+            err_stats e = (mode == FIR_FOLD_OFF) ? compare( y_ref.data(), y_ref.data(), n_out )
+                                                 : compare( y_ref.data(), y.data(), n_out );
+            printf( "%-10s %-7s %5s %9d %10.4f %10d %12.3f\n", c->name, fold_names[mode], f.symmetric ? "yes" : "no",
+                    e.max_abs, e.rms, e.mismatches, dt * 1e9 / n );
+        }
+    }
+
+    // end-to-end deviation from the direct-form receiver (= golden output)
+    const int n_audio = n / AUDIO_DECIM;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+
+    printf( "\n%-7s %9s %10s %10s %9s %10s %10s %12s\n", "fold", "L max", "L rms", "L mism", "R max", "R rms", "R mism", "ns/sample" );
+
+    for ( int mode = FIR_FOLD_OFF; mode <= FIR_FOLD_PREADD; mode++ )
+    {
+        FmReceiver rx;
+        rx.set_fir_fold( (fir_fold)mode );
+
+        int *l = (mode == FIR_FOLD_OFF) ? left_ref.data() : left.data();
+        int *r = (mode == FIR_FOLD_OFF) ? right_ref.data() : right.data();
+
+        // first pass warms up the scratch memory
+        rx.process( iq.data(), n, l, r );
+        rx.reset();
+
+        double t0 = now_sec();
+        rx.process( iq.data(), n, l, r );
+        double dt = now_sec() - t0;
+
+        err_stats el = compare( left_ref.data(), l, n_audio );
+        err_stats er = compare( right_ref.data(), r, n_audio );
+        printf( "%-7s %9d %10.4f %10d %9d %10.4f %10d %12.3f\n", fold_names[mode],
+                el.max_abs, el.rms, el.mismatches, er.max_abs, er.rms, er.mismatches, dt * 1e9 / n );
+    }
+
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// hardware cache-miss counters (pilot, tile)
+// -------------------------------------------------------
+
+// Hardware cache-miss counter for the calling thread. Reads -1 when the
+// kernel or the hypervisor does not expose the PMU (perf_event_paranoid,
+// containers, most VMs).
+struct miss_counter
+{
+    int fd;
+};
+
+static void miss_open( miss_counter *c, unsigned type, unsigned long long config )
+{
+    c->fd = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof(attr) );
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    c->fd = (int)syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+#endif
+}
+
+static void miss_start( miss_counter *c )
+{
+#ifdef __linux__
+    if ( c->fd < 0 ) return;
+    ioctl( c->fd, PERF_EVENT_IOC_RESET, 0 );
+    ioctl( c->fd, PERF_EVENT_IOC_ENABLE, 0 );
+#endif
+}
+
+static long long miss_stop( miss_counter *c )
+{
+    long long count = -1;
+#ifdef __linux__
+    if ( c->fd < 0 ) return -1;
+    ioctl( c->fd, PERF_EVENT_IOC_DISABLE, 0 );
+    if ( read( c->fd, &count, sizeof(count) ) != (ssize_t)sizeof(count) ) count = -1;
+#endif
+    return count;
+}
+
+static void miss_close( miss_counter *c )
+{
+    if ( c->fd >= 0 ) close( c->fd );
+    c->fd = -1;
+}
+
+// -------------------------------------------------------
+// pilot: fused vs. staged pilot / L-R demodulation
+// -------------------------------------------------------
+
+static int bench_pilot( const bench_opts *o )
+{
+    // the staged baseline runs untiled, so its intermediates are SAMPLES
+    // long; the last row is the default receiver (fused, GRAPH_TILE)
+    static const struct { int fused; int tile; } rows[] =
+    {
+        { 0, SAMPLES }, { 1, SAMPLES }, { 1, GRAPH_TILE },
+    };
+    const int n_rows = sizeof(rows) / sizeof(rows[0]);
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int runs = 5;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+
+    miss_counter l1d, llc;
+#ifdef __linux__
+    miss_open( &l1d, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+               (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) );
+    miss_open( &llc, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+#else
+    l1d.fd = llc.fd = -1;
+#endif
+
+    printf( "simd: %s, samples: %d, block: %d\n", simd_name(simd_get()), n, SAMPLES );
+    if ( l1d.fd < 0 && llc.fd < 0 )
+    {
+        printf( "hardware cache counters unavailable, miss columns show n/a\n" );
+    }
+    printf( "\n%-8s %7s %12s %12s %14s %14s %10s\n", "pilot", "tile", "ms/block", "ns/sample",
+            "L1D miss/smp", "LLC miss/smp", "bit-exact" );
+
+    for ( int k = 0; k < n_rows; k++ )
+    {
+        FmReceiver rx;
+        rx.set_pilot_fused( rows[k].fused );
+        rx.set_tile_samples( rows[k].tile );
+
+        int *l = (k == 0) ? left_ref.data() : left.data();
+        int *r = (k == 0) ? right_ref.data() : right.data();
+        double best = 1e30;
+        long long best_l1d = -1, best_llc = -1;
+
+        for ( int run = 0; run < runs; run++ )
+        {
+            rx.reset();
+            miss_start( &l1d );
+            miss_start( &llc );
+            double t0 = now_sec();
+            rx.process( iq.data(), n, l, r );
+            double dt = now_sec() - t0;
+            long long m1 = miss_stop( &l1d );
+            long long m2 = miss_stop( &llc );
+
+            if ( dt < best ) best = dt;
+            if ( m1 >= 0 && (best_l1d < 0 || m1 < best_l1d) ) best_l1d = m1;
+            if ( m2 >= 0 && (best_llc < 0 || m2 < best_llc) ) best_llc = m2;
+        }
+
+        const char *exact = (k == 0) ? "ref" : (left == left_ref && right == right_ref) ? "yes" : "NO";
+
+        char s_l1d[32], s_llc[32];
+        if ( best_l1d >= 0 ) snprintf( s_l1d, sizeof(s_l1d), "%.3f", (double)best_l1d / n );
+        else snprintf( s_l1d, sizeof(s_l1d), "n/a" );
+        if ( best_llc >= 0 ) snprintf( s_llc, sizeof(s_llc), "%.3f", (double)best_llc / n );
+        else snprintf( s_llc, sizeof(s_llc), "n/a" );
+
+        printf( "%-8s %7d %12.3f %12.3f %14s %14s %10s\n", rows[k].fused ? "fused" : "staged", rx.tile_samples(),
+                best * 1e3 * (SAMPLES) / n, best * 1e9 / n, s_l1d, s_llc, exact );
+    }
+
+    miss_close( &l1d );
+    miss_close( &llc );
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// tile: whole-graph tiling, time and cache misses per tile size
+// -------------------------------------------------------
+
+static int bench_tile( const bench_opts *o )
+{
+    static const int tiles[] = { 0, 65536, 32768, 16384, 8192, GRAPH_TILE, 2048, 1024, 512 };
+    const int n_tiles = sizeof(tiles) / sizeof(tiles[0]);
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int runs = 5;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+
+    miss_counter l1d, llc;
+#ifdef __linux__
+    miss_open( &l1d, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+               (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) );
+    miss_open( &llc, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+#else
+    l1d.fd = llc.fd = -1;
+#endif
+
+    printf( "simd: %s, samples: %d, block: %d, L2: %ld KB\n", simd_name(simd_get()), n, SAMPLES,
+            sysconf(_SC_LEVEL2_CACHE_SIZE) / 1024 );
+    if ( l1d.fd < 0 && llc.fd < 0 )
+    {
+        printf( "hardware cache counters unavailable, miss columns show n/a\n" );
+    }
+    printf( "\n%-7s %14s %12s %12s %14s %14s %10s\n", "tile", "scratch KB", "ms/block", "ns/sample",
+            "L1D miss/smp", "LLC miss/smp", "bit-exact" );
+
+    for ( int k = 0; k < n_tiles; k++ )
+    {
+        FmReceiver rx;
+        rx.set_tile_samples( tiles[k] );
+        const int tile = rx.tile_samples();
+
+        int *l = (k == 0) ? left_ref.data() : left.data();
+        int *r = (k == 0) ? right_ref.data() : right.data();
+        double best = 1e30;
+        long long best_l1d = -1, best_llc = -1;
+
+        for ( int run = 0; run < runs; run++ )
+        {
+            rx.reset();
+            miss_start( &l1d );
+            miss_start( &llc );
+            double t0 = now_sec();
+            rx.process( iq.data(), n, l, r );
+            double dt = now_sec() - t0;
+            long long m1 = miss_stop( &l1d );
+            long long m2 = miss_stop( &llc );
+
+            if ( dt < best ) best = dt;
+            if ( m1 >= 0 && (best_l1d < 0 || m1 < best_l1d) ) best_l1d = m1;
+            if ( m2 >= 0 && (best_llc < 0 || m2 < best_llc) ) best_llc = m2;
+        }
+
+        // I/Q input plus the ten sample-rate and six audio-rate scratch arrays
+        const long scratch = (long)tile * 4 + (10L * tile + 6L * (tile / AUDIO_DECIM)) * 4;
+        const char *exact = (k == 0) ? "ref" : (left == left_ref && right == right_ref) ? "yes" : "NO";
+
+        char s_l1d[32], s_llc[32];
+        if ( best_l1d >= 0 ) snprintf( s_l1d, sizeof(s_l1d), "%.3f", (double)best_l1d / n );
+        else snprintf( s_l1d, sizeof(s_l1d), "n/a" );
+        if ( best_llc >= 0 ) snprintf( s_llc, sizeof(s_llc), "%.3f", (double)best_llc / n );
+        else snprintf( s_llc, sizeof(s_llc), "n/a" );
+
+        printf( "%-7d %14ld %12.3f %12.3f %14s %14s %10s\n", tile, scratch / 1024, best * 1e3 * (SAMPLES) / n,
+                best * 1e9 / n, s_l1d, s_llc, exact );
+    }
+
+    miss_close( &l1d );
+    miss_close( &llc );
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// threads: branch-parallel LPR / BP_LMR / pilot section
+// -------------------------------------------------------
+
+static int bench_threads( const bench_opts *o )
+{
+    static const int tiles[] = { GRAPH_TILE, 16384, 0 };
+    const int n_tiles = sizeof(tiles) / sizeof(tiles[0]);
+    const int max_threads = 4;
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int runs = 5;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+
+    printf( "simd: %s, samples: %d, online cpus: %ld\n\n", simd_name(simd_get()), n, sysconf(_SC_NPROCESSORS_ONLN) );
+    printf( "%-7s %8s %12s %12s %10s %10s\n", "tile", "threads", "ms/tile", "ns/sample", "speedup", "bit-exact" );
+
+    for ( int t = 0; t < n_tiles; t++ )
+    {
+        double base = 0.0;
+
+        for ( int threads = 1; threads <= max_threads; threads++ )
+        {
+            FmReceiver rx;
+            rx.set_tile_samples( tiles[t] );
+            rx.set_threads( threads );
+
+            const int ref = (t == 0 && threads == 1);
+            int *l = ref ? left_ref.data() : left.data();
+            int *r = ref ? right_ref.data() : right.data();
+            double best = 1e30;
+
+            for ( int run = 0; run < runs; run++ )
+            {
+                rx.reset();
+                double t0 = now_sec();
+                rx.process( iq.data(), n, l, r );
+                double dt = now_sec() - t0;
+                if ( dt < best ) best = dt;
+            }
+            if ( threads == 1 ) base = best;
+
+            const char *exact = ref ? "ref" : (left == left_ref && right == right_ref) ? "yes" : "NO";
+            printf( "%-7d %8d %12.3f %12.3f %10.2f %10s\n", rx.tile_samples(), rx.threads(),
+                    best * 1e3 * rx.tile_samples() / n, best * 1e9 / n, base / best, exact );
+        }
+    }
+
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// pipeline: stage-per-thread receiver vs. the block receiver
+// -------------------------------------------------------
+
+struct mem_stream
+{
+    const unsigned char *iq;
+    int n;
+    int pos;
+    int *left;
+    int *right;
+    int out;
+};
+
+static int mem_source( void *arg, uint8_t *iq, int max_samples )
+{
+    mem_stream *m = (mem_stream *)arg;
+    int count = (m->n - m->pos < max_samples) ? (m->n - m->pos) : max_samples;
+
+    memcpy( iq, &m->iq[(size_t)m->pos * 4], (size_t)count * 4 );
+    m->pos += count;
+    return count;
+}
+
+static void mem_sink( void *arg, const int *left, const int *right, int n )
+{
+    mem_stream *m = (mem_stream *)arg;
+
+    memcpy( &m->left[m->out], left, n * sizeof(int) );
+    memcpy( &m->right[m->out], right, n * sizeof(int) );
+    m->out += n;
+}
+
+static int bench_pipeline( const bench_opts *o )
+{
+    static const int blocks[] = { 1280, FM_PIPE_BLOCK, 16384 };
+    const int n_blocks = sizeof(blocks) / sizeof(blocks[0]);
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int runs = 5;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+
+    printf( "simd: %s, samples: %d, online cpus: %ld\n\n", simd_name(simd_get()), n, sysconf(_SC_NPROCESSORS_ONLN) );
+
+    // sequential reference
+    double base = 1e30;
+    {
+        FmReceiver rx;
+        for ( int run = 0; run < runs; run++ )
+        {
+            rx.reset();
+            double t0 = now_sec();
+            rx.process( iq.data(), n, left_ref.data(), right_ref.data() );
+            double dt = now_sec() - t0;
+            if ( dt < base ) base = dt;
+        }
+    }
+
+    printf( "%-10s %7s %12s %10s %10s %10s   %s\n", "mode", "block", "ns/sample", "speedup", "stalls", "bit-exact",
+            "busy ns/sample per stage" );
+    printf( "%-10s %7d %12.3f %10.2f %10s %10s\n", "serial", GRAPH_TILE, base * 1e9 / n, 1.0, "-", "ref" );
+
+    for ( int b = 0; b < n_blocks; b++ )
+    {
+        FmPipeline pipe( blocks[b] );
+        double best = 1e30;
+        double busy[FM_PIPE_STAGES] = { 0 };
+        long stalls = 0;
+
+        for ( int run = 0; run < runs; run++ )
+        {
+            mem_stream m = { iq.data(), n, 0, left.data(), right.data(), 0 };
+
+            pipe.reset();
+            double t0 = now_sec();
+            pipe.run( mem_source, &m, mem_sink, &m );
+            double dt = now_sec() - t0;
+            if ( dt < best )
+            {
+                best = dt;
+                stalls = pipe.full_waits();
+                for ( int k = 0; k < FM_PIPE_STAGES; k++ ) busy[k] = pipe.stage_busy( k );
+            }
+        }
+
+        const char *exact = (left == left_ref && right == right_ref) ? "yes" : "NO";
+        printf( "%-10s %7d %12.3f %10.2f %10ld %10s  ", "pipeline", pipe.block_samples(), best * 1e9 / n, base / best,
+                stalls, exact );
+        for ( int k = 0; k < FM_PIPE_STAGES; k++ )
+        {
+            printf( " %s %.2f", FmPipeline::stage_name(k), busy[k] * 1e9 / n );
+        }
+        printf( "\n" );
+    }
+
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// chunks: segment-parallel decode of one capture
+// -------------------------------------------------------
+
+static int bench_chunks( const bench_opts *o )
+{
+    static const int warmups[] = { 0, 4, 16, 64, FM_CHUNK_IIR_WARMUP };
+    const int n_warmups = sizeof(warmups) / sizeof(warmups[0]);
+    const int max_segments = 8;
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int runs = 3;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+
+    printf( "simd: %s, samples: %d, online cpus: %ld\n\n", simd_name(simd_get()), n, sysconf(_SC_NPROCESSORS_ONLN) );
+
+    // sequential reference
+    double base = 1e30;
+    for ( int run = 0; run < runs; run++ )
+    {
+        FmReceiver rx( GRAPH_TILE );
+        double t0 = now_sec();
+        rx.process( iq.data(), n, left_ref.data(), right_ref.data() );
+        double dt = now_sec() - t0;
+        if ( dt < base ) base = dt;
+    }
+
+    printf( "%-9s %12s %10s %9s %10s\n", "segments", "ns/sample", "speedup", "max_err", "mismatch" );
+    printf( "%-9s %12.3f %10.2f %9s %10s\n", "serial", base * 1e9 / n, 1.0, "-", "ref" );
+
+    for ( int k = 1; k <= max_segments; k++ )
+    {
+        double best = 1e30;
+        for ( int run = 0; run < runs; run++ )
+        {
+            double t0 = now_sec();
+            fm_decode_chunks( iq.data(), n, left.data(), right.data(), k );
+            double dt = now_sec() - t0;
+            if ( dt < best ) best = dt;
+        }
+
+        err_stats el = compare( left_ref.data(), left.data(), n_audio );
+        err_stats er = compare( right_ref.data(), right.data(), n_audio );
+        printf( "%-9d %12.3f %10.2f %9d %10d\n", k, best * 1e9 / n, base / best,
+                el.max_abs > er.max_abs ? el.max_abs : er.max_abs, el.mismatches + er.mismatches );
+    }
+
+    // stitching error vs. deemphasis settling window
+    printf( "\n%-12s %9s %10s %10s\n", "iir warm-up", "max_err", "rms_err", "mismatch" );
+    for ( int w = 0; w < n_warmups; w++ )
+    {
+        fm_decode_chunks( iq.data(), n, left.data(), right.data(), max_segments, warmups[w] );
+
+        err_stats el = compare( left_ref.data(), left.data(), n_audio );
+        err_stats er = compare( right_ref.data(), right.data(), n_audio );
+        printf( "%-12d %9d %10.4f %10d\n", warmups[w], el.max_abs > er.max_abs ? el.max_abs : er.max_abs,
+                sqrt( (el.rms * el.rms + er.rms * er.rms) / 2 ), el.mismatches + er.mismatches );
+    }
+
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// demod: division-free qarctan / batch demodulator
+// -------------------------------------------------------
+
+static int bench_demod( const bench_opts *o )
+{
+    const int box = 2047;
+    const long n_random = 50000000;
+    const int max_d = 1 << 23;
+    long fails = 0;
+    long checks = 0;
+
+    printf( "simd: %s\n\n", simd_name(simd_get()) );
+
+    // every reachable denominator, at the numerators where the estimate is
+    // worst (largest |num|) and around the quotient steps next to them
+    double t0 = now_sec();
+    for ( int d = 1; d <= max_d; d++ )
+    {
+        const long lim = (d >= (1 << 21)) ? 2147483647L : 1024L * d;
+        const long q_top = lim / d;
+        const long cand[] = { lim, -lim, -lim - 1, q_top * d, q_top * d - 1, (q_top - 1) * d, (q_top - 1) * d + 1,
+                              d, d - 1, 0 };
+
+        for ( size_t c = 0; c < sizeof(cand) / sizeof(cand[0]); c++ )
+        {
+            if ( cand[c] < -2147483648L || cand[c] > lim ) continue;
+            const int num = (int)cand[c];
+            checks++;
+            if ( qdiv_rcp( num, d ) != num / d )
+            {
+                if ( fails++ < 10 ) printf( "  qdiv_rcp(%d, %d) = %d, expected %d\n", num, d, qdiv_rcp(num, d), num / d );
+            }
+        }
+    }
+    printf( "denominators 1..2^23       %12ld checks %8ld fail   %.2f s\n", checks, fails, now_sec() - t0 );
+
+    // every (y, x) in a box around the origin, where the quotients are small
+    long box_fails = 0;
+    t0 = now_sec();
+    for ( int y = -box; y <= box; y++ )
+    {
+        for ( int x = -box; x <= box; x++ )
+        {
+            if ( qarctan_rcp( y, x ) != qarctan( y, x ) ) box_fails++;
+        }
+    }
+    printf( "qarctan |x|,|y| <= %-6d %12ld pairs  %8ld fail   %.2f s\n", box, (long)(2*box+1) * (2*box+1), box_fails,
+            now_sec() - t0 );
+
+    // random pairs over the whole reachable range |x|, |y| < 2^22
+    long rnd_fails = 0;
+    unsigned int s = 12345;
+    t0 = now_sec();
+    for ( long k = 0; k < n_random; k++ )
+    {
+        s = s * 1664525u + 1013904223u; const int y = (int)(s >> 9) - (1 << 22) + 1;
+        s = s * 1664525u + 1013904223u; const int x = (int)(s >> 9) - (1 << 22) + 1;
+        if ( qarctan_rcp( y, x ) != qarctan( y, x ) ) rnd_fails++;
+    }
+    printf( "qarctan random |x|,|y|<2^22 %10ld pairs  %8ld fail   %.2f s\n", n_random, rnd_fails, now_sec() - t0 );
+
+    // batch demodulator on the channel-filtered capture
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int runs = 5;
+    std::vector<int> I(n), Q(n), I_fir(n), Q_fir(n), ref(n), out(n);
+    int x_real[MAX_TAPS] = {0}, x_imag[MAX_TAPS] = {0};
+    read_IQ( iq.data(), I.data(), Q.data(), n );
+    fir_cmplx_n( I.data(), Q.data(), n, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, x_real, x_imag,
+                 CHANNEL_COEFF_TAPS, 1, I_fir.data(), Q_fir.data() );
+
+    double t_ref = 1e30, t_block = 1e30;
+    for ( int run = 0; run < runs; run++ )
+    {
+        int real_prev = 0, imag_prev = 0;
+        t0 = now_sec();
+        for ( int i = 0; i < n; i++ )
+        {
+            demodulate( I_fir[i], Q_fir[i], &real_prev, &imag_prev, FM_DEMOD_GAIN, &ref[i] );
+        }
+        double dt = now_sec() - t0;
+        if ( dt < t_ref ) t_ref = dt;
+
+        real_prev = 0; imag_prev = 0;
+        t0 = now_sec();
+        demodulate_n( I_fir.data(), Q_fir.data(), &real_prev, &imag_prev, n, FM_DEMOD_GAIN, out.data() );
+        dt = now_sec() - t0;
+        if ( dt < t_block ) t_block = dt;
+    }
+
+    err_stats e = compare( ref.data(), out.data(), n );
+    printf( "\n%-14s %12s %10s %10s\n", "demodulate", "ns/sample", "speedup", "mismatch" );
+    printf( "%-14s %12.3f %10.2f %10s\n", "per-sample", t_ref * 1e9 / n, 1.0, "ref" );
+    printf( "%-14s %12.3f %10.2f %10d\n", "demodulate_n", t_block * 1e9 / n, t_ref / t_block, e.mismatches );
+
+    return (fails || box_fails || rnd_fails || e.mismatches) ? 1 : 0;
+}
+
+
+// -------------------------------------------------------
+// carrier: NCO / PLL vs. filter-based 38 kHz carrier
+// -------------------------------------------------------
+
+// power of the best-fit tone at hz, and of what is left after removing it
+// and the DC offset
+struct tone_fit
+{
+    double tone;
+    double residual;
+};
+
+static tone_fit fit_tone( const int *x, const int n, const double hz, const double rate )
+{
+    const double w = 2.0 * M_PI * hz / rate;
+    double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0, mean = 0;
+    tone_fit f = { 0.0, 0.0 };
+
+    for ( int i = 0; i < n; i++ ) mean += x[i];
+    mean /= n;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        const double s = sin( w * i ), c = cos( w * i ), v = x[i] - mean;
+        ss += s * s; sc += s * c; cc += c * c; xs += v * s; xc += v * c;
+    }
+
+    // least squares a*sin + b*cos
+    const double det = ss * cc - sc * sc;
+    const double a = (xs * cc - xc * sc) / det;
+    const double b = (xc * ss - xs * sc) / det;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        const double t = a * sin( w * i ) + b * cos( w * i );
+        const double r = x[i] - mean - t;
+        f.tone += t * t;
+        f.residual += r * r;
+    }
+    f.tone /= n;
+    f.residual /= n;
+    return f;
+}
+
+static int bench_carrier( const bench_opts *o )
+{
+    static const char *names[] = { "filter", "nco" };
+
+    fm_synth_params p;
+    fm_synth_defaults( &p );
+
+    // the Q10 products of the channel filter and demodulate() overflow int
+    // above ~45 ADC counts; stay below that so the audio is meaningful
+    p.iq_amp    = 32.0f;
+    p.noise_amp = 1.0f;
+
+    // the tone fit needs the synthetic capture
+    const int n = o->samples - (o->samples % AUDIO_DECIM);
+    std::vector<unsigned char> iq( (size_t)n * 4 );
+    fm_synth_stereo( iq.data(), 0, n, &p );
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int settle = AUDIO_RATE / 4;      // PLL acquisition and filter start-up
+    const int runs = 5;
+    if ( n_audio <= 2 * settle )
+    {
+        printf( "need more than %d samples\n", 2 * settle * AUDIO_DECIM );
+        return -1;
+    }
+
+    std::vector<int> left(n_audio), right(n_audio);
+
+    printf( "simd: %s, samples: %d, tones: L %.0f Hz, R %.0f Hz, pilot %.0f%%\n\n", simd_name(simd_get()), n,
+            p.left_hz, p.right_hz, p.pilot_amp * 100 );
+    printf( "%-8s %10s %10s %12s %12s %12s\n", "carrier", "L SNR dB", "R SNR dB", "L sep. dB", "R sep. dB", "ns/sample" );
+
+    for ( int mode = FM_CARRIER_FILTER; mode <= FM_CARRIER_NCO; mode++ )
+    {
+        FmReceiver rx;
+        rx.set_carrier( (fm_carrier)mode );
+        double best = 1e30;
+
+        for ( int run = 0; run < runs; run++ )
+        {
+            rx.reset();
+            double t0 = now_sec();
+            rx.process( iq.data(), n, left.data(), right.data() );
+            double dt = now_sec() - t0;
+            if ( dt < best ) best = dt;
+        }
+
+        const int m = n_audio - settle;
+        tone_fit ll = fit_tone( &left[settle], m, p.left_hz, AUDIO_RATE );
+        tone_fit lr = fit_tone( &left[settle], m, p.right_hz, AUDIO_RATE );
+        tone_fit rr = fit_tone( &right[settle], m, p.right_hz, AUDIO_RATE );
+        tone_fit rl = fit_tone( &right[settle], m, p.left_hz, AUDIO_RATE );
+
+        printf( "%-8s %10.2f %10.2f %12.2f %12.2f %12.3f\n", names[mode],
+                10 * log10( ll.tone / ll.residual ), 10 * log10( rr.tone / rr.residual ),
+                10 * log10( ll.tone / lr.tone ), 10 * log10( rr.tone / rl.tone ), best * 1e9 / n );
+    }
+
+    return 0;
+}
+
+
+// -------------------------------------------------------
+// iq: vectorized read_IQ and the history-prefixed channel filter
+// -------------------------------------------------------
+
+static int bench_iq( const bench_opts *o )
+{
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const simd_level active = simd_get();
+    const int runs = 20;
+    std::vector<int> I_ref(n), Q_ref(n), I(FIR_PREFIX + n), Q(FIR_PREFIX + n);
+    std::vector<int> y_real_ref(n), y_imag_ref(n), y_real(n), y_imag(n);
+    long fails = 0;
+
+    printf( "simd: %s, samples: %d\n\n", simd_name(active), n );
+    printf( "%-8s %12s %10s %10s\n", "read_IQ", "ns/sample", "speedup", "mismatch" );
+
+    double base = 0;
+    for ( int level = SIMD_SCALAR; level <= simd_detect(); level++ )
+    {
+        simd_set( (simd_level)level );
+        int *I_out = (level == SIMD_SCALAR) ? I_ref.data() : &I[FIR_PREFIX];
+        int *Q_out = (level == SIMD_SCALAR) ? Q_ref.data() : &Q[FIR_PREFIX];
+
+        double best = 1e30;
+        for ( int run = 0; run < runs; run++ )
+        {
+            double t0 = now_sec();
+            read_IQ( iq.data(), I_out, Q_out, n );
+            double dt = now_sec() - t0;
+            if ( dt < best ) best = dt;
+        }
+        if ( level == SIMD_SCALAR ) base = best;
+
+        err_stats ei = compare( I_ref.data(), I_out, n );
+        err_stats eq = compare( Q_ref.data(), Q_out, n );
+        fails += ei.mismatches + eq.mismatches;
+        printf( "%-8s %12.3f %10.2f %10d\n", simd_name((simd_level)level), best * 1e9 / n, base / best,
+                ei.mismatches + eq.mismatches );
+    }
+    simd_set( active );
+
+    // channel filter on plain planes vs. planes with the history in front
+    fir_cmplx_filter f;
+    fir_cmplx_setup( &f, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, CHANNEL_COEFF_TAPS, 1 );
+    double t_plain = 1e30, t_prefixed = 1e30;
+    for ( int run = 0; run < runs; run++ )
+    {
+        // tile-sized blocks, as FmReceiver runs them
+        fir_cmplx_reset( &f );
+        double t0 = now_sec();
+        for ( int i = 0; i < n; i += GRAPH_TILE )
+        {
+            const int m = (n - i < GRAPH_TILE) ? n - i : GRAPH_TILE;
+            read_IQ( &iq[(size_t)i * 4], &I_ref[i], &Q_ref[i], m );
+            fir_cmplx_filter_n( &f, &I_ref[i], &Q_ref[i], m, &y_real_ref[i], &y_imag_ref[i] );
+        }
+        double dt = now_sec() - t0;
+        if ( dt < t_plain ) t_plain = dt;
+
+        fir_cmplx_reset( &f );
+        t0 = now_sec();
+        for ( int i = 0; i < n; i += GRAPH_TILE )
+        {
+            const int m = (n - i < GRAPH_TILE) ? n - i : GRAPH_TILE;
+            read_IQ( &iq[(size_t)i * 4], &I[FIR_PREFIX], &Q[FIR_PREFIX], m );
+            fir_cmplx_filter_prefixed( &f, &I[FIR_PREFIX], &Q[FIR_PREFIX], m, &y_real[i], &y_imag[i] );
+        }
+        dt = now_sec() - t0;
+        if ( dt < t_prefixed ) t_prefixed = dt;
+    }
+
+    err_stats er = compare( y_real_ref.data(), y_real.data(), n );
+    err_stats ei = compare( y_imag_ref.data(), y_imag.data(), n );
+    fails += er.mismatches + ei.mismatches;
+    printf( "\n%-22s %12s %10s\n", "channel filter", "ns/sample", "mismatch" );
+    printf( "%-22s %12.3f %10s\n", "read_IQ + filter_n", t_plain * 1e9 / n, "ref" );
+    printf( "%-22s %12.3f %10d\n", "read_IQ + prefixed", t_prefixed * 1e9 / n, er.mismatches + ei.mismatches );
+
+    return fails ? 1 : 0;
+}
+
+
+// -------------------------------------------------------
+// output: fused add / sub -> deemphasis -> gain -> s16 stage
+// -------------------------------------------------------
+
+static int bench_output( const bench_opts *o )
+{
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    const int runs = 20;
+    std::vector<int> lpr(n_audio), lmr(n_audio), left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+    std::vector<int> l_raw(n_audio), r_raw(n_audio), l_de(n_audio), r_de(n_audio);
+    std::vector<short> pcm_ref( 2 * n_audio ), pcm( 2 * n_audio );
+    long fails = 0;
+
+    // the audio FIR outputs of the capture feed the stage
+    {
+        std::vector<int> I(n), Q(n), I_fir(n), Q_fir(n), demod(n);
+        int x_real[MAX_TAPS] = {0}, x_imag[MAX_TAPS] = {0}, x_lpr[MAX_TAPS] = {0}, x_lmr[MAX_TAPS] = {0};
+        int real_prev = 0, imag_prev = 0;
+        read_IQ( iq.data(), I.data(), Q.data(), n );
+        fir_cmplx_n( I.data(), Q.data(), n, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, x_real, x_imag,
+                     CHANNEL_COEFF_TAPS, 1, I_fir.data(), Q_fir.data() );
+        demodulate_n( I_fir.data(), Q_fir.data(), &real_prev, &imag_prev, n, FM_DEMOD_GAIN, demod.data() );
+        fir_n( demod.data(), n, AUDIO_LPR_COEFFS, x_lpr, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM, lpr.data() );
+        fir_n( demod.data(), n, AUDIO_LMR_COEFFS, x_lmr, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM, lmr.data() );
+    }
+
+    printf( "simd: %s, audio samples: %d\n\n", simd_name(simd_get()), n_audio );
+    printf( "%-22s %12s %10s %10s\n", "output stage", "ns/sample", "speedup", "mismatch" );
+
+    // six passes plus the repack the sink used to do
+    double base = 1e30;
+    for ( int run = 0; run < runs; run++ )
+    {
+        int lx[MAX_TAPS] = {0}, ly[MAX_TAPS] = {0}, rx[MAX_TAPS] = {0}, ry[MAX_TAPS] = {0};
+        double t0 = now_sec();
+        add_n( lpr.data(), lmr.data(), n_audio, l_raw.data() );
+        sub_n( lpr.data(), lmr.data(), n_audio, r_raw.data() );
+        deemphasis_n( l_raw.data(), lx, ly, n_audio, l_de.data() );
+        deemphasis_n( r_raw.data(), rx, ry, n_audio, r_de.data() );
+        gain_n( l_de.data(), n_audio, VOLUME_LEVEL, left_ref.data() );
+        gain_n( r_de.data(), n_audio, VOLUME_LEVEL, right_ref.data() );
+        for ( int i = 0; i < n_audio; i++ )
+        {
+            pcm_ref[2*i+0] = (short)((left_ref[i] > 32767) ? 32767 : (left_ref[i] < -32768) ? -32768 : left_ref[i]);
+            pcm_ref[2*i+1] = (short)((right_ref[i] > 32767) ? 32767 : (right_ref[i] < -32768) ? -32768 : right_ref[i]);
+        }
+        double dt = now_sec() - t0;
+        if ( dt < base ) base = dt;
+    }
+    printf( "%-22s %12.3f %10.2f %10s\n", "six passes + repack", base * 1e9 / n_audio, 1.0, "ref" );
+
+    const simd_level active = simd_get();
+    for ( int level = SIMD_SCALAR; level <= simd_detect(); level++ )
+    {
+        simd_set( (simd_level)level );
+
+        double best = 1e30;
+        for ( int run = 0; run < runs; run++ )
+        {
+            int lx[MAX_TAPS] = {0}, ly[MAX_TAPS] = {0}, rx[MAX_TAPS] = {0}, ry[MAX_TAPS] = {0};
+            double t0 = now_sec();
+            stereo_out_n( lpr.data(), lmr.data(), n_audio, lx, ly, rx, ry, VOLUME_LEVEL, NULL, NULL, pcm.data() );
+            double dt = now_sec() - t0;
+            if ( dt < best ) best = dt;
+        }
+
+        // the int outputs must match as well, in blocks to exercise the state hand-over
+        int lx[MAX_TAPS] = {0}, ly[MAX_TAPS] = {0}, rx[MAX_TAPS] = {0}, ry[MAX_TAPS] = {0};
+        for ( int i = 0; i < n_audio; i += 1000 )
+        {
+            const int m = (n_audio - i < 1000) ? n_audio - i : 1000;
+            stereo_out_n( &lpr[i], &lmr[i], m, lx, ly, rx, ry, VOLUME_LEVEL, &left[i], &right[i], NULL );
+        }
+
+        int bad = compare( left_ref.data(), left.data(), n_audio ).mismatches + compare( right_ref.data(), right.data(), n_audio ).mismatches;
+        for ( int i = 0; i < 2 * n_audio; i++ )
+        {
+            if ( pcm[i] != pcm_ref[i] ) bad++;
+        }
+        fails += bad;
+
+        char name[32];
+        snprintf( name, sizeof(name), "fused %s", simd_name((simd_level)level) );
+        printf( "%-22s %12.3f %10.2f %10d\n", name, best * 1e9 / n_audio, base / best, bad );
+    }
+    simd_set( active );
+
+    return fails ? 1 : 0;
+}
+
+
+// -------------------------------------------------------
+// latency: input-to-output delay and per-block cost vs. block size
+// -------------------------------------------------------
+
+static int bench_latency( const bench_opts *o )
+{
+    static const int blocks[] = { 256, 512, 1024, 2048, 4096, 16384, 65536, SAMPLES };
+    const int n_blocks = sizeof(blocks) / sizeof(blocks[0]);
+
+    std::vector<unsigned char> iq;
+    const int n = load_iq( o, iq );
+    if ( n <= 0 ) return -1;
+
+    const int n_audio = n / AUDIO_DECIM;
+    std::vector<int> left_ref(n_audio), right_ref(n_audio), left(n_audio), right(n_audio);
+    long fails = 0;
+
+    {
+        FmReceiver rx( SAMPLES );
+        rx.process( iq.data(), n, left_ref.data(), right_ref.data() );
+    }
+
+    // delay of the graph itself: half the channel and AUDIO_LPR windows at the
+    // quad rate, plus the audio sample iir() holds back
+    const double filter_ms = 1e3 * ((CHANNEL_COEFF_TAPS - 1) / 2.0 + (AUDIO_LPR_COEFF_TAPS - 1) / 2.0 + AUDIO_DECIM) / QUAD_RATE;
+
+    printf( "simd: %s, samples: %d, filter delay: %.3f ms\n", simd_name(simd_get()), n, filter_ms );
+    printf( "latency = block fill + p99 block CPU + filter delay\n\n" );
+    printf( "%8s %9s %11s %11s %11s %8s %11s %10s\n", "block", "fill ms", "cpu us med", "cpu us p99", "cpu us max",
+            "load %", "latency ms", "bit-exact" );
+
+    for ( int b = 0; b < n_blocks; b++ )
+    {
+        const int block = blocks[b];
+        if ( block > n ) break;
+
+        FmReceiver rx( block );
+        std::vector<double> cost;
+        cost.reserve( n / block + 1 );
+
+        // feed the capture the way a live source would, one block per call
+        int out = 0;
+        for ( int i = 0; i < n; i += block )
+        {
+            const int m = (n - i < block) ? n - i : block;
+            double t0 = now_sec();
+            out += rx.process( &iq[(size_t)i * 4], m, &left[out], &right[out] );
+            cost.push_back( now_sec() - t0 );
+        }
+
+        // the last block may be short; rank the full ones
+        if ( n % block != 0 && cost.size() > 1 ) cost.pop_back();
+        std::sort( cost.begin(), cost.end() );
+        const double med = cost[cost.size() / 2];
+        const double p99 = cost[(size_t)((cost.size() - 1) * 0.99)];
+        const double max = cost.back();
+        const double fill_ms = 1e3 * block / QUAD_RATE;
+
+        const int bad = compare( left_ref.data(), left.data(), n_audio ).mismatches +
+                        compare( right_ref.data(), right.data(), n_audio ).mismatches;
+        fails += bad;
+
+        printf( "%8d %9.3f %11.1f %11.1f %11.1f %8.1f %11.3f %10s\n", block, fill_ms, med * 1e6, p99 * 1e6, max * 1e6,
+                100.0 * med * 1e3 / fill_ms, fill_ms + p99 * 1e3 + filter_ms, bad ? "NO" : "yes" );
+    }
+
+    return fails ? 1 : 0;
+}
+
+
+// -------------------------------------------------------
+// input: fread() copy vs. memory-mapped capture
+// -------------------------------------------------------
+
+// read the capture in SAMPLES blocks the way main.cpp used to
+static long input_fread( const char *path, int *I, int *Q, std::vector<unsigned char> &buf )
+{
+    FILE *f = fopen( path, "rb" );
+    if ( f == NULL ) return -1;
+
+    long total = 0;
+    size_t n;
+    while ( (n = fread( buf.data(), 4, SAMPLES, f )) > 0 )
+    {
+        read_IQ( buf.data(), I, Q, (int)n );
+        total += (long)n;
+    }
+    fclose( f );
+    return total;
+}
+
+static long input_mmap( const char *path, int *I, int *Q )
+{
+    fm_input in;
+    if ( fm_input_open( &in, path ) < 0 ) return -1;
+
+    long total = 0;
+    const uint8_t *iq;
+    int n;
+    while ( (n = fm_input_next( &in, SAMPLES, &iq )) > 0 )
+    {
+        read_IQ( iq, I, Q, n );
+        total += n;
+    }
+    fm_input_close( &in );
+    return total;
+}
+
+// evict the file from the page cache so the next read goes to the device
+static void input_evict( const char *path )
+{
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 ) return;
+    fdatasync( fd );
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    close( fd );
+}
+
+static int bench_input( const bench_opts *o )
+{
+    static const char *names[] = { "fread", "mmap" };
+    char tmp[] = "/tmp/fm_bench_XXXXXX";
+    const char *path = o->input;
+
+    // without -i write the synthetic capture to a scratch file
+    if ( path == NULL )
+    {
+        std::vector<unsigned char> iq;
+        const int n = load_iq( o, iq );
+        int fd = mkstemp( tmp );
+        if ( n <= 0 || fd < 0 ) return -1;
+        if ( write( fd, iq.data(), iq.size() ) != (ssize_t)iq.size() )
+        {
+            printf( "Cannot write %s\n", tmp );
+            close( fd );
+            unlink( tmp );
+            return -1;
+        }
+        close( fd );
+        path = tmp;
+    }
+
+    const int runs = 5;
+    std::vector<int> I(SAMPLES), Q(SAMPLES);
+    std::vector<unsigned char> buf( (size_t)SAMPLES * 4 );
+    long total = 0;
+
+    printf( "simd: %s, input: %s, block: %d samples\n\n", simd_name(simd_get()), path, SAMPLES );
+    printf( "%-6s %16s %16s\n", "input", "warm ns/sample", "cold ns/sample" );
+
+    for ( int mode = 0; mode < 2; mode++ )
+    {
+        double warm = 1e30;
+        double cold = 1e30;
+
+        for ( int run = 0; run < 2 * runs; run++ )
+        {
+            // odd runs start from an empty page cache
+            if ( run & 1 ) input_evict( path );
+
+            double t0 = now_sec();
+            total = (mode == 0) ? input_fread( path, I.data(), Q.data(), buf ) : input_mmap( path, I.data(), Q.data() );
+            double dt = now_sec() - t0;
+            if ( total <= 0 ) break;
+
+            double &best = (run & 1) ? cold : warm;
+            if ( dt < best ) best = dt;
+        }
+        if ( total <= 0 ) break;
+
+        printf( "%-6s %16.3f %16.3f\n", names[mode], warm * 1e9 / total, cold * 1e9 / total );
+    }
+
+    // end to end: the mapped blocks feed FmReceiver directly
+    if ( total > 0 )
+    {
+        fm_input in;
+        const uint8_t *iq;
+        int n;
+        long audio = 0;
+        std::vector<int> left(AUDIO_SAMPLES), right(AUDIO_SAMPLES);
+        FmReceiver rx( SAMPLES );
+
+        fm_input_open( &in, path );
+        double t0 = now_sec();
+        while ( (n = fm_input_next( &in, SAMPLES, &iq )) > 0 )
+        {
+            audio += rx.process( iq, n, left.data(), right.data() );
+        }
+        double dt = now_sec() - t0;
+        fm_input_close( &in );
+
+        printf( "\ndecode from mapping: %ld samples -> %ld audio, %.3f ns/sample\n", total, audio, dt * 1e9 / total );
+    }
+
+    if ( path == tmp ) unlink( tmp );
+    return (total > 0) ? 0 : -1;
+}
+
+
+// -------------------------------------------------------
+// kernels: regression suite, one JSON line per kernel
+// -------------------------------------------------------
+
+#define KERNEL_BLOCK    65536   // samples per timed call
+#define KERNEL_REPS     101
+
+struct kernel_ctx
+{
+    int n;
+    const unsigned char *iq;
+    int *I, *Q, *I_fir, *Q_fir, *demod, *out;
+    int x[MAX_TAPS], y[MAX_TAPS], x_imag[MAX_TAPS];
+    const int *coeff;
+    int taps;
+    int decimation;
+
+    // end to end
+    FmReceiver *rx;
+    const unsigned char *capture;
+    int capture_n;
+    int *left, *right;
+};
+
+typedef void (*kernel_fn)( kernel_ctx *c );
+
+static void k_read_iq( kernel_ctx *c )
+{
+    read_IQ( c->iq, c->I, c->Q, c->n );
+}
+
+static void k_fir( kernel_ctx *c )
+{
+    fir_n( c->demod, c->n, c->coeff, c->x, c->taps, c->decimation, c->out );
+}
+
+static void k_fir_cmplx( kernel_ctx *c )
+{
+    fir_cmplx_n( c->I, c->Q, c->n, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, c->x, c->x_imag,
+                 CHANNEL_COEFF_TAPS, 1, c->out, &c->out[c->n] );
+}
+
+static void k_demod( kernel_ctx *c )
+{
+    int real_prev = 0, imag_prev = 0;
+    demodulate_n( c->I_fir, c->Q_fir, &real_prev, &imag_prev, c->n, FM_DEMOD_GAIN, c->out );
+}
+
+static void k_qarctan( kernel_ctx *c )
+{
+    for ( int i = 0; i < c->n; i++ )
+    {
+        c->out[i] = qarctan( c->Q_fir[i], c->I_fir[i] );
+    }
+}
+
+static void k_iir( kernel_ctx *c )
+{
+    deemphasis_n( c->demod, c->x, c->y, c->n, c->out );
+}
+
+static void k_end_to_end( kernel_ctx *c )
+{
+    c->rx->reset();
+    c->rx->process( c->capture, c->capture_n, c->left, c->right );
+}
+
+struct kernel_result
+{
+    char name[64];
+    int samples;
+    double median_ns;
+    double p99_ns;
+    double ns_per_sample;
+};
+
+static kernel_result time_kernel( const char *name, kernel_fn fn, kernel_ctx *c, const int samples, const int reps )
+{
+    std::vector<double> t( reps );
+    kernel_result r;
+
+    fn( c );    // warm the caches and the dispatch
+    for ( int k = 0; k < reps; k++ )
+    {
+        double t0 = now_sec();
+        fn( c );
+        t[k] = (now_sec() - t0) * 1e9;
+    }
+    std::sort( t.begin(), t.end() );
+
+    snprintf( r.name, sizeof(r.name), "%s", name );
+    r.samples = samples;
+    r.median_ns = t[reps / 2];
+    r.p99_ns = t[(size_t)((reps - 1) * 0.99)];
+    r.ns_per_sample = r.median_ns / samples;
+    return r;
+}
+
+static void print_result( FILE *f, const kernel_result *r, const char *simd )
+{
+    fprintf( f, "{\"kernel\": \"%s\", \"samples\": %d, \"median_ns\": %.0f, \"p99_ns\": %.0f, "
+                "\"ns_per_sample\": %.4f, \"simd\": \"%s\"}\n",
+             r->name, r->samples, r->median_ns, r->p99_ns, r->ns_per_sample, simd );
+}
+
+// ns/sample of name, measured at the given SIMD level, in a stored run;
+// -1 when it is not there
+static double baseline_lookup( const char *path, const char *name, const char *simd )
+{
+    FILE *f = fopen( path, "r" );
+    char line[512];
+    double found = -1;
+
+    if ( f == NULL ) return -1;
+    while ( fgets( line, sizeof(line), f ) != NULL )
+    {
+        char kernel[64];
+        char level[16];
+        int samples = 0;
+        double median = 0, p99 = 0, per_sample = 0;
+        if ( sscanf( line, "{\"kernel\": \"%63[^\"]\", \"samples\": %d, \"median_ns\": %lf, \"p99_ns\": %lf, "
+                           "\"ns_per_sample\": %lf, \"simd\": \"%15[^\"]\"", kernel, &samples, &median, &p99, &per_sample,
+                     level ) == 6 &&
+             strcmp( kernel, name ) == 0 && strcmp( level, simd ) == 0 )
+        {
+            found = per_sample;
+        }
+    }
+    fclose( f );
+    return found;
+}
+
+static int bench_kernels( const bench_opts *o )
+{
+    // kernel names carry taps/decimation, e.g. "fir_n audio_lpr 32/8"
+    struct fir_case
+    {
+        const char *filter;
+        const int *coeff;
+        int taps;
+        int decimation;
+    };
+    static const fir_case firs[] =
+    {
+        { "audio_lpr", AUDIO_LPR_COEFFS, AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM },
+        { "audio_lmr", AUDIO_LMR_COEFFS, AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM },
+        { "bp_lmr",    BP_LMR_COEFFS,    BP_LMR_COEFF_TAPS,    1 },
+        { "bp_pilot",  BP_PILOT_COEFFS,  BP_PILOT_COEFF_TAPS,  1 },
+        { "hp",        HP_COEFFS,        HP_COEFF_TAPS,        1 },
+    };
+    const int n_firs = sizeof(firs) / sizeof(firs[0]);
+    const int n = KERNEL_BLOCK;
+    const char *simd = simd_name( simd_get() );
+
+    FILE *out = NULL;
+    if ( o->output != NULL && (out = fopen( o->output, "w" )) == NULL )
+    {
+        printf( "Cannot write %s\n", o->output );
+        return -1;
+    }
+
+    // kernel inputs: the synthetic capture through the real chain
+    bench_opts synth = *o;
+    synth.input = NULL;
+    synth.samples = n;
+    std::vector<unsigned char> iq;
+    load_iq( &synth, iq );
+
+    std::vector<int> I(n), Q(n), I_fir(n), Q_fir(n), demod(n), buf(2 * n);
+    kernel_ctx c;
+    memset( &c, 0, sizeof(c) );
+    c.n = n;
+    c.iq = iq.data();
+    c.I = I.data(); c.Q = Q.data(); c.I_fir = I_fir.data(); c.Q_fir = Q_fir.data();
+    c.demod = demod.data(); c.out = buf.data();
+
+    read_IQ( c.iq, c.I, c.Q, n );
+    fir_cmplx_n( c.I, c.Q, n, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG, c.x, c.x_imag, CHANNEL_COEFF_TAPS, 1, c.I_fir, c.Q_fir );
+    k_demod( &c );
+    memcpy( c.demod, c.out, n * sizeof(int) );
+
+    std::vector<kernel_result> results;
+    char name[64];
+    results.push_back( time_kernel( "read_IQ", k_read_iq, &c, n, KERNEL_REPS ) );
+    snprintf( name, sizeof(name), "fir_cmplx_n channel %d/1", CHANNEL_COEFF_TAPS );
+    results.push_back( time_kernel( name, k_fir_cmplx, &c, n, KERNEL_REPS ) );
+    results.push_back( time_kernel( "demodulate_n", k_demod, &c, n, KERNEL_REPS ) );
+    results.push_back( time_kernel( "qarctan", k_qarctan, &c, n, KERNEL_REPS ) );
+    for ( int k = 0; k < n_firs; k++ )
+    {
+        c.coeff = firs[k].coeff;
+        c.taps = firs[k].taps;
+        c.decimation = firs[k].decimation;
+        snprintf( name, sizeof(name), "fir_n %s %d/%d", firs[k].filter, firs[k].taps, firs[k].decimation );
+        results.push_back( time_kernel( name, k_fir, &c, n, KERNEL_REPS ) );
+    }
+    snprintf( name, sizeof(name), "iir_n deemphasis %d/1", IIR_COEFF_TAPS );
+    results.push_back( time_kernel( name, k_iir, &c, n, KERNEL_REPS ) );
+
+    // end to end, SAMPLES-sized blocks as fm_radio_stereo() runs them
+    std::vector<unsigned char> capture;
+    bench_opts e2e = *o;
+    e2e.input = NULL;
+    e2e.samples = SAMPLES;
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        if ( pass == 1 )
+        {
+            if ( o->input == NULL ) break;
+            e2e.input = o->input;
+        }
+
+        const int m = load_iq( &e2e, capture );
+        if ( m <= 0 ) break;
+
+        FmReceiver rx( SAMPLES );
+        std::vector<int> left( m / AUDIO_DECIM ), right( m / AUDIO_DECIM );
+        c.rx = &rx;
+        c.capture = capture.data();
+        c.capture_n = m;
+        c.left = left.data();
+        c.right = right.data();
+        results.push_back( time_kernel( pass ? "fm_radio_stereo recorded" : "fm_radio_stereo synthetic", k_end_to_end,
+                                        &c, m, 11 ) );
+    }
+
+    int regressions = 0;
+    int compared = 0;
+    int missing = 0;
+    for ( size_t k = 0; k < results.size(); k++ )
+    {
+        print_result( stdout, &results[k], simd );
+        if ( out != NULL ) print_result( out, &results[k], simd );
+
+        if ( o->baseline == NULL ) continue;
+
+        // a baseline taken at another SIMD level says nothing about this run;
+        // a kernel without one fails, or a rename or another ISA would pass
+        // unchecked
+        const double base = baseline_lookup( o->baseline, results[k].name, simd );
+        if ( base <= 0 )
+        {
+            fprintf( stderr, "MISSING %s: no %s baseline\n", results[k].name, simd );
+            missing++;
+            continue;
+        }
+
+        compared++;
+        if ( results[k].ns_per_sample > base * (1.0 + o->tolerance) )
+        {
+            fprintf( stderr, "REGRESSION %s: %.4f ns/sample, baseline %.4f (+%.0f%%, limit +%.0f%%)\n", results[k].name,
+                     results[k].ns_per_sample, base, 100.0 * (results[k].ns_per_sample / base - 1.0), 100.0 * o->tolerance );
+            regressions++;
+        }
+    }
+
+    if ( out != NULL ) fclose( out );
+    fflush( stdout );
+    if ( o->baseline != NULL )
+    {
+        fprintf( stderr, "%d of %d kernels regressed against %s, %d missing from it\n", regressions, compared,
+                 o->baseline, missing );
+    }
+    return (regressions || missing) ? 1 : 0;
+}
+
+
+// -------------------------------------------------------
+// precision: int32 / int16 storage at several Q formats vs. float
+// -------------------------------------------------------
+
+#define PRECISION_RUNS  3
+#define PRECISION_HEAD  15      // |sample| < 2^15 after the input shift
+#define PRECISION_SKIP  MAX_TAPS    // audio samples of start-up transient left out
+
+// one configuration of FmFixedReceiver; returns the best time of
+// PRECISION_RUNS passes
+typedef double (*precision_fn)( const unsigned char *iq, int n, int in_shift, int *left, int *right );
+
+template <typename T, int FRAC>
+static double precision_run( const unsigned char *iq, int n, int in_shift, int *left, int *right )
+{
+    FmFixedReceiver<T, FRAC> rx( SAMPLES, in_shift );
+    double best = 1e30;
+
+    for ( int run = 0; run < PRECISION_RUNS; run++ )
+    {
+        rx.reset();
+        double t0 = now_sec();
+        rx.process( iq, n, left, right );
+        double dt = now_sec() - t0;
+        if ( dt < best ) best = dt;
+    }
+    return best;
+}
+
+// signal to error power of x against the reference, dB
+static double snr_db( const double *ref, const int *x, const int n, double *max_abs )
+{
+    double sig = 0.0, err = 0.0;
+    *max_abs = 0.0;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        const double e = x[i] - ref[i];
+        sig += ref[i] * ref[i];
+        err += e * e;
+        if ( fabs( e ) > *max_abs ) *max_abs = fabs( e );
+    }
+    return (err > 0.0) ? 10 * log10( sig / err ) : INFINITY;
+}
+
+static int bench_precision( const bench_opts *o )
+{
+    struct precision_config
+    {
+        const char *type;
+        int frac;
+        precision_fn run;
+    };
+    static const precision_config configs[] =
+    {
+        { "int32", 8,  precision_run<int, 8> },
+        { "int32", 10, precision_run<int, 10> },
+        { "int32", 12, precision_run<int, 12> },
+        { "int32", 14, precision_run<int, 14> },
+        { "int16", 6,  precision_run<int16_t, 6> },
+        { "int16", 8,  precision_run<int16_t, 8> },
+        { "int16", 10, precision_run<int16_t, 10> },
+        { "int16", 12, precision_run<int16_t, 12> },
+    };
+    const int n_configs = sizeof(configs) / sizeof(configs[0]);
+
+    std::vector<unsigned char> iq;
+    int n = 0;
+    if ( o->input == NULL )
+    {
+        // small enough for the unshifted int32 Q10 path (see carrier)
+        fm_synth_params p;
+        fm_synth_defaults( &p );
+        p.iq_amp    = 24.0f;
+        p.noise_amp = 1.0f;
+
+        n = o->samples - (o->samples % AUDIO_DECIM);
+        iq.assign( (size_t)n * 4, 0 );
+        fm_synth_stereo( iq.data(), 0, n, &p );
+    }
+    else if ( (n = load_iq( o, iq )) <= 0 )
+    {
+        return -1;
+    }
+
+    // bits of the largest input sample sets the input shift of every
+    // configuration: |sample| << FRAC >> shift stays below 2^PRECISION_HEAD
+    int peak = 0;
+    for ( int i = 0; i < 2 * n; i++ )
+    {
+        const int v = abs( (short)(iq[2*i+1] << 8 | iq[2*i]) );
+        if ( v > peak ) peak = v;
+    }
+    int peak_bits = 0;
+    while ( (1 << peak_bits) <= peak ) peak_bits++;
+
+    const int n_audio = n / AUDIO_DECIM;
+    std::vector<double> ref_l(n_audio), ref_r(n_audio);
+    std::vector<int> left(n_audio), right(n_audio);
+
+    {
+        FmFixedReceiver<double, BITS> ref( SAMPLES, 0 );
+        ref.process( iq.data(), n, ref_l.data(), ref_r.data() );
+    }
+
+    printf( "simd: %s, samples: %d, input peak: %d (%d bits), reference: double Q%d\n\n", simd_name(simd_get()), n, peak,
+            peak_bits, BITS );
+    printf( "%-6s %4s %6s %10s %10s %10s %10s %12s\n", "type", "Q", "shift", "L SNR dB", "R SNR dB", "L max|e|",
+            "R max|e|", "ns/sample" );
+
+    int exact = -1;
+    for ( int k = 0; k < n_configs; k++ )
+    {
+        int shift = peak_bits + configs[k].frac - PRECISION_HEAD;
+        if ( shift < 0 ) shift = 0;
+
+        const double dt = configs[k].run( iq.data(), n, shift, left.data(), right.data() );
+
+        double max_l = 0, max_r = 0;
+        const int m = n_audio - PRECISION_SKIP;
+        const double snr_l = snr_db( &ref_l[PRECISION_SKIP], &left[PRECISION_SKIP], m, &max_l );
+        const double snr_r = snr_db( &ref_r[PRECISION_SKIP], &right[PRECISION_SKIP], m, &max_r );
+        printf( "%-6s %4d %6d %10.2f %10.2f %10.0f %10.0f %12.3f\n", configs[k].type, configs[k].frac, shift, snr_l, snr_r,
+                max_l, max_r, dt * 1e9 / n );
+
+        // the int32 Q10 path without a shift is the one fm_radio.cpp runs
+        if ( strcmp( configs[k].type, "int32" ) == 0 && configs[k].frac == BITS && shift == 0 )
+        {
+            FmReceiver rx;
+            std::vector<int> rx_l(n_audio), rx_r(n_audio);
+            rx.process( iq.data(), n, rx_l.data(), rx_r.data() );
+            exact = compare( rx_l.data(), left.data(), n_audio ).mismatches +
+                    compare( rx_r.data(), right.data(), n_audio ).mismatches;
+        }
+    }
+
+    if ( exact < 0 )
+    {
+        printf( "\nint32 Q%d needs an input shift here; not compared with FmReceiver\n", BITS );
+    }
+    else
+    {
+        printf( "\nint32 Q%d vs. FmReceiver: %d mismatching audio samples\n", BITS, exact );
+    }
+    return (exact > 0) ? 1 : 0;
+}
+
+
+static void usage()
+{
+    printf( "Usage: fm_bench <command> [-i input.dat] [-n samples]\n" );
+    printf( "       fm_bench kernels [-i input.dat] [-o out.jsonl] [-b baseline.jsonl] [-t tolerance]\n" );
+    printf( "Commands:\n" );
+    printf( "  fold     deviation and speed of the folded symmetric FIR variants\n" );
+    printf( "  pilot    fused vs. staged pilot / L-R demodulation\n" );
+    printf( "  tile     whole-graph tile size sweep: time and cache misses\n" );
+    printf( "  threads  branch-parallel LPR / BP_LMR / pilot section vs. thread count\n" );
+    printf( "  pipeline stage-per-thread receiver with SPSC block queues vs. serial\n" );
+    printf( "  chunks   segment-parallel decode of one capture: speedup and stitching error\n" );
+    printf( "  demod    division-free qarctan: exactness sweep and batch demodulator speed\n" );
+    printf( "  carrier  NCO / PLL vs. filter-based 38 kHz carrier: SNR and separation\n" );
+    printf( "  iq       vectorized read_IQ per SIMD level, history-prefixed channel filter\n" );
+    printf( "  output   fused add/sub -> deemphasis -> gain -> s16 stage vs. six passes\n" );
+    printf( "  latency  input-to-output delay and per-block CPU cost vs. block size\n" );
+    printf( "  kernels  regression suite: median / p99 per kernel as JSON lines, fails past the baseline\n" );
+    printf( "  input    fread() vs. memory-mapped capture, warm and cold page cache\n" );
+    printf( "  precision int32 / int16 storage at Q6..Q14: SNR against the float reference\n" );
+}
+
+int main( int argc, char **argv )
+{
+    bench_opts o;
+    o.input   = NULL;
+    o.samples = SAMPLES;
+    o.output    = NULL;
+    o.baseline  = NULL;
+    o.tolerance = 0.25;
+
+    if ( argc < 2 )
+    {
+        usage();
+        return -1;
+    }
+
+    for ( int i = 2; i < argc; i++ )
+    {
+        if ( strcmp(argv[i], "-i") == 0 && i + 1 < argc )
+        {
+            o.input = argv[++i];
+        }
+        else if ( strcmp(argv[i], "-n") == 0 && i + 1 < argc )
+        {
+            o.samples = atoi( argv[++i] );
+        }
+        else if ( strcmp(argv[i], "-o") == 0 && i + 1 < argc )
+        {
+            o.output = argv[++i];
+        }
+        else if ( strcmp(argv[i], "-b") == 0 && i + 1 < argc )
+        {
+            o.baseline = argv[++i];
+        }
+        else if ( strcmp(argv[i], "-t") == 0 && i + 1 < argc )
+        {
+            o.tolerance = atof( argv[++i] );
+        }
+        else
+        {
+            usage();
+            return -1;
+        }
+    }
+
+    if ( strcmp(argv[1], "fold") == 0 )
+    {
+        return bench_fold( &o );
+    }
+
+    if ( strcmp(argv[1], "pilot") == 0 )
+    {
+        return bench_pilot( &o );
+    }
+
+    if ( strcmp(argv[1], "tile") == 0 )
+    {
+        return bench_tile( &o );
+    }
+
+    if ( strcmp(argv[1], "threads") == 0 )
+    {
+        return bench_threads( &o );
+    }
+
+    if ( strcmp(argv[1], "pipeline") == 0 )
+    {
+        return bench_pipeline( &o );
+    }
+
+    if ( strcmp(argv[1], "chunks") == 0 )
+    {
+        return bench_chunks( &o );
+    }
+
+    if ( strcmp(argv[1], "demod") == 0 )
+    {
+        return bench_demod( &o );
+    }
+
+    if ( strcmp(argv[1], "carrier") == 0 )
+    {
+        return bench_carrier( &o );
+    }
+
+    if ( strcmp(argv[1], "iq") == 0 )
+    {
+        return bench_iq( &o );
+    }
+
+    if ( strcmp(argv[1], "output") == 0 )
+    {
+        return bench_output( &o );
+    }
+
+    if ( strcmp(argv[1], "latency") == 0 )
+    {
+        return bench_latency( &o );
+    }
+
+    if ( strcmp(argv[1], "kernels") == 0 )
+    {
+        return bench_kernels( &o );
+    }
+
+    if ( strcmp(argv[1], "input") == 0 )
+    {
+        return bench_input( &o );
+    }
+
+    if ( strcmp(argv[1], "precision") == 0 )
+    {
+        return bench_precision( &o );
+    }
+
+    usage();
+    return -1;
+}
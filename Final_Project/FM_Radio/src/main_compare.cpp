@@ -0,0 +1,420 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "fm_dump.h"
+#include "fm_pool.h"
+
+// -------------------------------------------------------
+// fm_compare: golden vs. simulation
+//
+//   fm_compare [options] <golden_dir> <sim_dir> [signal[:lag]]...
+//
+// For each signal <name> the golden side is <golden_dir>/
+// <name>.bin (fm_golden), or <name>.txt, and the simulation
+// side is <sim_dir>/<name>.txt or <name>.bin. Text files
+// hold one integer per line (decimal, or $readmemh hex with
+// -x). Sample i + lag of the simulation is compared with
+// golden sample i, so a positive lag skips the pipeline
+// latency at the start of the sim output.
+//
+// Every signal reports the first mismatch, max |error|, RMS
+// error and a histogram of |error| in power-of-two buckets.
+// A sim output that ends before the golden one fails too:
+// the golden samples it never reached count as missing.
+// Signals are loaded and compared in parallel on an FmPool.
+// Exits 1 when any signal mismatches, is short or is missing.
+// -------------------------------------------------------
+
+#define HIST_BUCKETS    32      // bucket k: 2^(k-1) <= |e| < 2^k, bucket 0 unused
+
+// the signals fm_golden dumps, in pipeline order
+static const char *golden_signals[] =
+{
+    "in_I", "in_Q", "ch_I", "ch_Q", "demod",
+    "audio_lpr", "bp_lmr", "bp_pilot", "pilot_sq", "pilot_38k",
+    "lmr_bb", "audio_lmr", "left_raw", "right_raw",
+    "left_deemph", "right_deemph", "out_left", "out_right",
+};
+
+struct compare_opts
+{
+    const char *golden_dir;
+    const char *sim_dir;
+    int lag;            // default latency offset
+    int tolerance;      // |error| <= tolerance counts as a match
+    int hex;            // text files are $readmemh hex
+    int explicit_list;  // signals named on the command line
+};
+
+struct compare_job
+{
+    const compare_opts *o;
+    char name[64];
+    int lag;
+
+    // results
+    int status;             // 0 ok, -1 missing / unreadable
+    char message[640];
+    long long golden_n, sim_n, compared;
+    long long short_n;      // golden samples past the end of the sim output
+    long long mismatches;
+    long long first;        // golden index of the first mismatch, -1 if none
+    int first_golden, first_sim;
+    long long max_abs;
+    double rms;
+    long long hist[HIST_BUCKETS];
+};
+
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int file_exists( const char *path )
+{
+    struct stat st;
+    return stat( path, &st ) == 0;
+}
+
+// one integer per line (any whitespace between values)
+static int parse_text( const char *p, const char *end, int hex, std::vector<int> &out )
+{
+    out.clear();
+    out.reserve( (end - p) / 4 );
+
+    while ( p < end )
+    {
+        while ( p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ) p++;
+        if ( p >= end ) break;
+
+        // $readmemh files may carry // comments
+        if ( *p == '/' )
+        {
+            while ( p < end && *p != '\n' ) p++;
+            continue;
+        }
+
+        if ( hex )
+        {
+            unsigned int u = 0;
+            const char *q = p;
+            for ( ; p < end; p++ )
+            {
+                const char c = *p;
+                if ( c >= '0' && c <= '9' )      u = (u << 4) | (unsigned int)(c - '0');
+                else if ( c >= 'a' && c <= 'f' ) u = (u << 4) | (unsigned int)(c - 'a' + 10);
+                else if ( c >= 'A' && c <= 'F' ) u = (u << 4) | (unsigned int)(c - 'A' + 10);
+                else break;
+            }
+            if ( p == q ) return -1;
+            out.push_back( (int)u );
+        }
+        else
+        {
+            const int neg = (*p == '-');
+            if ( *p == '-' || *p == '+' ) p++;
+            const char *q = p;
+            long long v = 0;
+            for ( ; p < end && *p >= '0' && *p <= '9'; p++ )
+            {
+                v = v * 10 + (*p - '0');
+            }
+            if ( p == q ) return -1;
+            out.push_back( (int)(neg ? -v : v) );
+        }
+    }
+    return 0;
+}
+
+// <dir>/<name>.bin or .txt, the order given by bin_first
+static int load_signal( const char *dir, const char *name, int bin_first, int hex, std::vector<int> &out, char *path,
+                        int path_size )
+{
+    char bin[512], txt[512];
+    snprintf( bin, sizeof(bin), "%s/%s.bin", dir, name );
+    snprintf( txt, sizeof(txt), "%s/%s.txt", dir, name );
+
+    const char *pick = bin_first ? (file_exists( bin ) ? bin : txt) : (file_exists( txt ) ? txt : bin);
+    snprintf( path, path_size, "%s", pick );
+
+    if ( pick == bin )
+    {
+        fm_dump_view v;
+        if ( fm_dump_map( &v, bin ) != 0 ) return -1;
+        out.resize( v.info.length );
+        for ( long long i = 0; i < v.info.length; i++ )
+        {
+            out[i] = fm_dump_sample( &v, i );
+        }
+        fm_dump_unmap( &v );
+        return 0;
+    }
+
+    int fd = open( txt, O_RDONLY );
+    if ( fd < 0 ) return -1;
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    if ( st.st_size == 0 )
+    {
+        close( fd );
+        out.clear();
+        return 0;
+    }
+
+    void *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED ) return -1;
+    madvise( map, st.st_size, MADV_SEQUENTIAL );
+
+    const int rc = parse_text( (const char *)map, (const char *)map + st.st_size, hex, out );
+    munmap( map, st.st_size );
+    return rc;
+}
+
+static int bucket( long long e )
+{
+    int k = 0;
+    while ( e > 0 && k < HIST_BUCKETS - 1 )
+    {
+        e >>= 1;
+        k++;
+    }
+    return k;
+}
+
+static void compare_task( void *arg )
+{
+    compare_job *j = (compare_job *)arg;
+    const compare_opts *o = j->o;
+    std::vector<int> golden, sim;
+    char golden_path[512], sim_path[512];
+
+    j->first = -1;
+    if ( load_signal( o->golden_dir, j->name, 1, o->hex, golden, golden_path, sizeof(golden_path) ) != 0 )
+    {
+        snprintf( j->message, sizeof(j->message), "cannot read %s", golden_path );
+        j->status = -1;
+        return;
+    }
+    if ( load_signal( o->sim_dir, j->name, 0, o->hex, sim, sim_path, sizeof(sim_path) ) != 0 )
+    {
+        snprintf( j->message, sizeof(j->message), "cannot read %s", sim_path );
+        j->status = -1;
+        return;
+    }
+
+    j->golden_n = (long long)golden.size();
+    j->sim_n = (long long)sim.size();
+
+    // golden[i] against sim[i + lag]
+    const long long g0 = (j->lag < 0) ? -j->lag : 0;
+    const long long s0 = (j->lag > 0) ? j->lag : 0;
+    long long n = j->golden_n - g0;
+    if ( j->sim_n - s0 < n ) n = j->sim_n - s0;
+    if ( n < 0 ) n = 0;
+    j->compared = n;
+    j->short_n = (j->golden_n > g0) ? j->golden_n - g0 - n : 0;
+
+    double sum_sq = 0;
+    for ( long long i = 0; i < n; i++ )
+    {
+        const long long e = (long long)sim[s0 + i] - golden[g0 + i];
+        const long long a = (e < 0) ? -e : e;
+        if ( a == 0 ) continue;
+
+        sum_sq += (double)e * e;
+        if ( a > j->max_abs ) j->max_abs = a;
+        j->hist[bucket( a )]++;
+        if ( a > o->tolerance )
+        {
+            if ( j->first < 0 )
+            {
+                j->first = g0 + i;
+                j->first_golden = golden[g0 + i];
+                j->first_sim = sim[s0 + i];
+            }
+            j->mismatches++;
+        }
+    }
+    j->rms = (n > 0) ? sqrt( sum_sq / n ) : 0.0;
+    j->status = 0;
+}
+
+static void report( const compare_job *j )
+{
+    if ( j->status != 0 )
+    {
+        printf( "%-13s MISSING  %s\n", j->name, j->message );
+        return;
+    }
+
+    printf( "%-13s %-8s n=%lld lag=%d mismatches=%lld max|e|=%lld rms=%.3f", j->name,
+            (j->mismatches || j->short_n) ? "FAIL" : "ok", j->compared, j->lag, j->mismatches, j->max_abs, j->rms );
+    if ( j->golden_n - j->compared != (j->lag < 0 ? -j->lag : 0) || j->sim_n - j->compared != (j->lag > 0 ? j->lag : 0) )
+    {
+        printf( " (golden %lld, sim %lld samples)", j->golden_n, j->sim_n );
+    }
+    printf( "\n" );
+
+    if ( j->first >= 0 )
+    {
+        printf( "    first mismatch at %lld: golden %d, sim %d\n", j->first, j->first_golden, j->first_sim );
+    }
+    if ( j->short_n > 0 )
+    {
+        printf( "    sim ends %lld samples short: golden %lld.. never compared\n", j->short_n, j->golden_n - j->short_n );
+    }
+    if ( j->max_abs > 0 )
+    {
+        printf( "    |e| histogram:" );
+        for ( int k = 1; k < HIST_BUCKETS; k++ )
+        {
+            if ( j->hist[k] == 0 ) continue;
+            const long long lo = 1LL << (k - 1), hi = (1LL << k) - 1;
+            if ( lo == hi ) printf( " %lld:%lld", lo, j->hist[k] );
+            else            printf( " %lld-%lld:%lld", lo, hi, j->hist[k] );
+        }
+        printf( "\n" );
+    }
+}
+
+static void usage()
+{
+    printf( "Usage: fm_compare [-l lag] [-e tolerance] [-x] [-j threads] <golden_dir> <sim_dir> [signal[:lag]]...\n" );
+    printf( "  -l  sim sample i+lag is compared with golden sample i (default 0)\n" );
+    printf( "  -e  |error| up to this still counts as a match (default 0)\n" );
+    printf( "  -x  text files are $readmemh hex instead of decimal\n" );
+    printf( "  -j  worker threads besides the main one (default: online CPUs - 1)\n" );
+    printf( "  without signals every fm_golden signal found in golden_dir is compared\n" );
+    printf( "  e.g. fm_compare test imp/sim demod:5 out_left:40 out_right:40\n" );
+}
+
+int main( int argc, char **argv )
+{
+    compare_opts o;
+    memset( &o, 0, sizeof(o) );
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    int workers = (cpus > 1) ? (int)cpus - 1 : 0;
+    int arg = 1;
+
+    for ( ; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++ )
+    {
+        if ( strcmp(argv[arg], "-l") == 0 && arg + 1 < argc )
+        {
+            o.lag = atoi( argv[++arg] );
+        }
+        else if ( strcmp(argv[arg], "-e") == 0 && arg + 1 < argc )
+        {
+            o.tolerance = atoi( argv[++arg] );
+        }
+        else if ( strcmp(argv[arg], "-x") == 0 )
+        {
+            o.hex = 1;
+        }
+        else if ( strcmp(argv[arg], "-j") == 0 && arg + 1 < argc )
+        {
+            workers = atoi( argv[++arg] );
+        }
+        else
+        {
+            usage();
+            return -1;
+        }
+    }
+
+    if ( argc - arg < 2 )
+    {
+        usage();
+        return -1;
+    }
+    o.golden_dir = argv[arg++];
+    o.sim_dir = argv[arg++];
+    o.explicit_list = (arg < argc);
+
+    std::vector<compare_job> jobs;
+    if ( o.explicit_list )
+    {
+        for ( ; arg < argc; arg++ )
+        {
+            compare_job j;
+            memset( &j, 0, sizeof(j) );
+            j.o = &o;
+            j.lag = o.lag;
+            const char *colon = strchr( argv[arg], ':' );
+            const int len = colon ? (int)(colon - argv[arg]) : (int)strlen( argv[arg] );
+            snprintf( j.name, sizeof(j.name), "%.*s", len, argv[arg] );
+            if ( colon ) j.lag = atoi( colon + 1 );
+            jobs.push_back( j );
+        }
+    }
+    else
+    {
+        const int n = sizeof(golden_signals) / sizeof(golden_signals[0]);
+        for ( int k = 0; k < n; k++ )
+        {
+            char bin[512], txt[512];
+            snprintf( bin, sizeof(bin), "%s/%s.bin", o.golden_dir, golden_signals[k] );
+            snprintf( txt, sizeof(txt), "%s/%s.txt", o.golden_dir, golden_signals[k] );
+            if ( !file_exists( bin ) && !file_exists( txt ) ) continue;
+
+            compare_job j;
+            memset( &j, 0, sizeof(j) );
+            j.o = &o;
+            j.lag = o.lag;
+            snprintf( j.name, sizeof(j.name), "%s", golden_signals[k] );
+            jobs.push_back( j );
+        }
+        if ( jobs.empty() )
+        {
+            printf( "No golden signals in %s\n", o.golden_dir );
+            return -1;
+        }
+    }
+
+    const double t0 = now_sec();
+    {
+        FmPool pool( workers );
+        fm_task fn[FM_POOL_MAX_TASKS];
+        void *args[FM_POOL_MAX_TASKS];
+
+        for ( size_t k = 0; k < jobs.size(); k += FM_POOL_MAX_TASKS )
+        {
+            int n = 0;
+            for ( ; n < FM_POOL_MAX_TASKS && k + n < jobs.size(); n++ )
+            {
+                fn[n] = compare_task;
+                args[n] = &jobs[k + n];
+            }
+            pool.run( fn, args, n );
+        }
+    }
+    const double elapsed = now_sec() - t0;
+
+    int failed = 0;
+    for ( size_t k = 0; k < jobs.size(); k++ )
+    {
+        report( &jobs[k] );
+        if ( jobs[k].status != 0 || jobs[k].mismatches > 0 || jobs[k].short_n > 0 ) failed++;
+    }
+
+    printf( "%d of %d signals %s (%.3f s)\n", failed ? failed : (int)jobs.size(), (int)jobs.size(),
+            failed ? "failed" : "match", elapsed );
+    return failed ? 1 : 0;
+}
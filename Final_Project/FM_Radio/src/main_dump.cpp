@@ -0,0 +1,98 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fm_dump.h"
+
+// -------------------------------------------------------
+// fm_dump: converts binary golden dumps (fm_golden .bin)
+// to the text or $readmemh forms the SV testbenches load.
+//
+//   fm_dump [-x] <signal.bin> [out|-]     text, or hex with -x
+//   fm_dump -i <signal.bin>...            header summary
+//
+// Without an output path the result goes next to the input
+// with the extension replaced (.txt / .hex).
+// -------------------------------------------------------
+
+static void usage()
+{
+    printf( "Usage: fm_dump [-x] <signal.bin> [out|-]\n" );
+    printf( "       fm_dump -i <signal.bin>...\n" );
+    printf( "  -x  $readmemh hex (8 digits, two's complement) instead of one %%d per line\n" );
+    printf( "  -i  print name, rate, Q format, start and length\n" );
+}
+
+static int info( const char *path )
+{
+    fm_dump_view v;
+    if ( fm_dump_map( &v, path ) != 0 )
+    {
+        return -1;
+    }
+
+    printf( "%s: %s, %d Hz, Q%d, samples %lld..%lld (%lld)\n", path, v.info.name, v.info.rate, v.info.frac_bits,
+            (long long)v.info.start, (long long)(v.info.start + v.info.length), (long long)v.info.length );
+    fm_dump_unmap( &v );
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    fm_dump_format format = FM_DUMP_TEXT;
+    int show_info = 0;
+    int arg = 1;
+
+    for ( ; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++ )
+    {
+        if ( strcmp(argv[arg], "-x") == 0 )
+        {
+            format = FM_DUMP_HEX;
+        }
+        else if ( strcmp(argv[arg], "-i") == 0 )
+        {
+            show_info = 1;
+        }
+        else
+        {
+            usage();
+            return -1;
+        }
+    }
+
+    if ( arg >= argc || (!show_info && argc - arg > 2) )
+    {
+        usage();
+        return -1;
+    }
+
+    if ( show_info )
+    {
+        int rc = 0;
+        for ( ; arg < argc; arg++ )
+        {
+            if ( info( argv[arg] ) != 0 ) rc = -1;
+        }
+        return rc;
+    }
+
+    const char *in_path = argv[arg];
+    char out_path[1024];
+
+    if ( arg + 1 < argc )
+    {
+        snprintf( out_path, sizeof(out_path), "%s", argv[arg + 1] );
+    }
+    else
+    {
+        // signal.bin -> signal.txt / signal.hex
+        const char *ext = (format == FM_DUMP_HEX) ? ".hex" : ".txt";
+        const char *dot = strrchr( in_path, '.' );
+        const char *slash = strrchr( in_path, '/' );
+        int stem = (dot != NULL && (slash == NULL || dot > slash)) ? (int)(dot - in_path) : (int)strlen( in_path );
+        snprintf( out_path, sizeof(out_path), "%.*s%s", stem, in_path, ext );
+    }
+
+    return fm_dump_convert( in_path, out_path, format );
+}
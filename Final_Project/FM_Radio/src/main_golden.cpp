@@ -3,30 +3,127 @@
 #include <stdlib.h>
 #include <string.h>
 #include "fm_radio.h"
+#include "fm_dump.h"
+#include "fm_input.h"
 
 // -------------------------------------------------------
 // Golden reference generator
 // Runs the full FM radio pipeline and dumps all
 // intermediate signals to test/ for FPGA verification.
+//
+// The whole capture is streamed through the pipeline in
+// SAMPLES-sized blocks with the filter state carried over,
+// so a dump anywhere in a recording matches a continuous
+// run. -w start,length restricts the dumps to a window of
+// input samples (audio-rate signals get the matching
+// decimated window) and -d picks the signals to dump;
+// processing stops at the end of the window.
+//
+// Every signal goes to <name>.bin (see fm_dump.h); -t and
+// -x also write the <name>.txt / <name>.hex forms the SV
+// testbenches read. fm_dump converts a .bin later on.
 // -------------------------------------------------------
 
-#define DUMP_INT(fname, arr, n) dump_int(fname, arr, n)
+enum golden_signal
+{
+    SIG_IN_I, SIG_IN_Q, SIG_CH_I, SIG_CH_Q, SIG_DEMOD,
+    SIG_AUDIO_LPR, SIG_BP_LMR, SIG_BP_PILOT, SIG_PILOT_SQ, SIG_PILOT_38K,
+    SIG_LMR_BB, SIG_AUDIO_LMR, SIG_LEFT_RAW, SIG_RIGHT_RAW,
+    SIG_LEFT_DEEMPH, SIG_RIGHT_DEEMPH, SIG_OUT_LEFT, SIG_OUT_RIGHT,
+    N_SIGNALS
+};
+
+// frac: Q format of the samples; gain_n() shifts its output up to Q14
+static const struct { const char *name; int decim; int frac; } signals[N_SIGNALS] =
+{
+    { "in_I",         1,           BITS }, { "in_Q",          1,           BITS },
+    { "ch_I",         1,           BITS }, { "ch_Q",          1,           BITS },
+    { "demod",        1,           BITS }, { "audio_lpr",     AUDIO_DECIM, BITS },
+    { "bp_lmr",       1,           BITS }, { "bp_pilot",      1,           BITS },
+    { "pilot_sq",     1,           BITS }, { "pilot_38k",     1,           BITS },
+    { "lmr_bb",       1,           BITS }, { "audio_lmr",     AUDIO_DECIM, BITS },
+    { "left_raw",     AUDIO_DECIM, BITS }, { "right_raw",     AUDIO_DECIM, BITS },
+    { "left_deemph",  AUDIO_DECIM, BITS }, { "right_deemph",  AUDIO_DECIM, BITS },
+    { "out_left",     AUDIO_DECIM, 14 },   { "out_right",     AUDIO_DECIM, 14 },
+};
 
-static void dump_int(const char *path, int *arr, int n)
+struct golden_opts
 {
-    FILE *f = fopen(path, "w");
-    if (!f) { printf("ERROR: cannot open %s\n", path); return; }
-    for (int i = 0; i < n; i++)
-        fprintf(f, "%d\n", arr[i]);
-    fclose(f);
-    printf("  [dump] %s (%d samples)\n", path, n);
+    const char *out_dir;
+    int text;               // also write <name>.txt
+    int hex;                // also write <name>.hex ($readmemh)
+    long long start;        // first input sample to dump
+    long long length;       // input samples to dump, -1 = to the end
+    int selected[N_SIGNALS];
+    fm_dump dump[N_SIGNALS];
+};
+
+// input sample window [start, end) at the rate of signal s
+static void signal_window(const golden_opts *g, int s, long long *w0, long long *w1)
+{
+    const int d = signals[s].decim;
+    *w0 = (g->start + d - 1) / d;
+    *w1 = (g->length < 0) ? -1 : (g->start + g->length + d - 1) / d;
 }
 
-void fm_radio_golden(unsigned char *IQ,
-                     int *left_audio, int *right_audio,
-                     const char *out_dir)
+static int open_dumps(golden_opts *g)
 {
     char path[256];
+    for (int s = 0; s < N_SIGNALS; s++) {
+        if (!g->selected[s]) continue;
+        long long w0, w1;
+        signal_window(g, s, &w0, &w1);
+        snprintf(path, sizeof(path), "%s/%s.bin", g->out_dir, signals[s].name);
+        if (fm_dump_open(&g->dump[s], path, signals[s].name, QUAD_RATE / signals[s].decim, signals[s].frac, w0) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void close_dumps(golden_opts *g)
+{
+    char path[256], conv[256];
+    for (int s = 0; s < N_SIGNALS; s++) {
+        if (!g->selected[s]) continue;
+        const long long n = g->dump[s].info.length, w0 = g->dump[s].info.start;
+        snprintf(path, sizeof(path), "%s/%s.bin", g->out_dir, signals[s].name);
+        if (fm_dump_close(&g->dump[s]) != 0) { printf("ERROR: write failed on %s\n", path); continue; }
+        printf("  [dump] %s (%lld samples from %lld)\n", path, n, w0);
+
+        if (g->text) {
+            snprintf(conv, sizeof(conv), "%s/%s.txt", g->out_dir, signals[s].name);
+            fm_dump_convert(path, conv, FM_DUMP_TEXT);
+        }
+        if (g->hex) {
+            snprintf(conv, sizeof(conv), "%s/%s.hex", g->out_dir, signals[s].name);
+            fm_dump_convert(path, conv, FM_DUMP_HEX);
+        }
+    }
+}
+
+// arr holds n samples of signal s; arr[0] is sample pos of the block at the
+// signal's rate (input sample pos * decim)
+#define DUMP_INT(sig, arr, n) dump_int(g, sig, arr, n, pos / signals[sig].decim)
+
+static void dump_int(golden_opts *g, int s, const int *arr, int n, long long pos)
+{
+    if (!g->selected[s]) return;
+
+    long long w0, w1;
+    signal_window(g, s, &w0, &w1);
+    long long a = (pos > w0) ? pos : w0;
+    long long b = (w1 < 0 || pos + n < w1) ? pos + n : w1;
+    if (b > a) fm_dump_write(&g->dump[s], &arr[a - pos], (int)(b - a));
+}
+
+// Runs one block of n input samples (a multiple of AUDIO_DECIM, at most
+// SAMPLES) starting at input sample pos. Filter state carries over between
+// calls.
+void fm_radio_golden(const unsigned char *IQ, int n, long long pos,
+                     int *left_audio, int *right_audio,
+                     golden_opts *g)
+{
+    const int n_audio = n / AUDIO_DECIM;
 
     // ---------- internal buffers ----------
     static int I[SAMPLES],   Q[SAMPLES];
@@ -51,102 +148,181 @@ void fm_radio_golden(unsigned char *IQ,
     static int deemph_r_x[MAX_TAPS], deemph_r_y[MAX_TAPS];
 
     // ---------- pipeline ----------
-    read_IQ(IQ, I, Q, SAMPLES);
-    snprintf(path, sizeof(path), "%s/in_I.txt",         out_dir); DUMP_INT(path, I, SAMPLES);
-    snprintf(path, sizeof(path), "%s/in_Q.txt",         out_dir); DUMP_INT(path, Q, SAMPLES);
+    read_IQ(IQ, I, Q, n);
+    DUMP_INT(SIG_IN_I, I, n);
+    DUMP_INT(SIG_IN_Q, Q, n);
 
-    fir_cmplx_n(I, Q, SAMPLES, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG,
+    fir_cmplx_n(I, Q, n, CHANNEL_COEFFS_REAL, CHANNEL_COEFFS_IMAG,
                 fir_cmplx_x_real, fir_cmplx_x_imag,
                 CHANNEL_COEFF_TAPS, 1, I_fir, Q_fir);
-    snprintf(path, sizeof(path), "%s/ch_I.txt",         out_dir); DUMP_INT(path, I_fir, SAMPLES);
-    snprintf(path, sizeof(path), "%s/ch_Q.txt",         out_dir); DUMP_INT(path, Q_fir, SAMPLES);
+    DUMP_INT(SIG_CH_I, I_fir, n);
+    DUMP_INT(SIG_CH_Q, Q_fir, n);
 
-    demodulate_n(I_fir, Q_fir, demod_real, demod_imag, SAMPLES, FM_DEMOD_GAIN, demod);
-    snprintf(path, sizeof(path), "%s/demod.txt",        out_dir); DUMP_INT(path, demod, SAMPLES);
+    demodulate_n(I_fir, Q_fir, demod_real, demod_imag, n, FM_DEMOD_GAIN, demod);
+    DUMP_INT(SIG_DEMOD, demod, n);
 
     // L+R path
-    fir_n(demod, SAMPLES, AUDIO_LPR_COEFFS, fir_lpr_x,
+    fir_n(demod, n, AUDIO_LPR_COEFFS, fir_lpr_x,
           AUDIO_LPR_COEFF_TAPS, AUDIO_DECIM, audio_lpr_filter);
-    snprintf(path, sizeof(path), "%s/audio_lpr.txt",    out_dir); DUMP_INT(path, audio_lpr_filter, AUDIO_SAMPLES);
+    DUMP_INT(SIG_AUDIO_LPR, audio_lpr_filter, n_audio);
 
     // L-R bandpass
-    fir_n(demod, SAMPLES, BP_LMR_COEFFS, fir_bp_x,
+    fir_n(demod, n, BP_LMR_COEFFS, fir_bp_x,
           BP_LMR_COEFF_TAPS, 1, bp_lmr_filter);
-    snprintf(path, sizeof(path), "%s/bp_lmr.txt",       out_dir); DUMP_INT(path, bp_lmr_filter, SAMPLES);
+    DUMP_INT(SIG_BP_LMR, bp_lmr_filter, n);
 
     // Pilot bandpass
-    fir_n(demod, SAMPLES, BP_PILOT_COEFFS, fir_pilot_x,
+    fir_n(demod, n, BP_PILOT_COEFFS, fir_pilot_x,
           BP_PILOT_COEFF_TAPS, 1, bp_pilot_filter);
-    snprintf(path, sizeof(path), "%s/bp_pilot.txt",     out_dir); DUMP_INT(path, bp_pilot_filter, SAMPLES);
+    DUMP_INT(SIG_BP_PILOT, bp_pilot_filter, n);
 
     // Square pilot → 38 kHz + DC
-    multiply_n(bp_pilot_filter, bp_pilot_filter, SAMPLES, square);
-    snprintf(path, sizeof(path), "%s/pilot_sq.txt",     out_dir); DUMP_INT(path, square, SAMPLES);
+    multiply_n(bp_pilot_filter, bp_pilot_filter, n, square);
+    DUMP_INT(SIG_PILOT_SQ, square, n);
 
     // HP filter → remove DC
-    fir_n(square, SAMPLES, HP_COEFFS, fir_hp_x,
+    fir_n(square, n, HP_COEFFS, fir_hp_x,
           HP_COEFF_TAPS, 1, hp_pilot_filter);
-    snprintf(path, sizeof(path), "%s/pilot_38k.txt",    out_dir); DUMP_INT(path, hp_pilot_filter, SAMPLES);
+    DUMP_INT(SIG_PILOT_38K, hp_pilot_filter, n);
 
     // Demodulate L-R
-    multiply_n(hp_pilot_filter, bp_lmr_filter, SAMPLES, multiply);
-    snprintf(path, sizeof(path), "%s/lmr_bb.txt",       out_dir); DUMP_INT(path, multiply, SAMPLES);
+    multiply_n(hp_pilot_filter, bp_lmr_filter, n, multiply);
+    DUMP_INT(SIG_LMR_BB, multiply, n);
 
     // L-R LPF + decimation
-    fir_n(multiply, SAMPLES, AUDIO_LMR_COEFFS, fir_lmr_x,
+    fir_n(multiply, n, AUDIO_LMR_COEFFS, fir_lmr_x,
           AUDIO_LMR_COEFF_TAPS, AUDIO_DECIM, audio_lmr_filter);
-    snprintf(path, sizeof(path), "%s/audio_lmr.txt",    out_dir); DUMP_INT(path, audio_lmr_filter, AUDIO_SAMPLES);
+    DUMP_INT(SIG_AUDIO_LMR, audio_lmr_filter, n_audio);
 
     // Stereo reconstruction
-    add_n(audio_lpr_filter, audio_lmr_filter, AUDIO_SAMPLES, left);
-    sub_n(audio_lpr_filter, audio_lmr_filter, AUDIO_SAMPLES, right);
-    snprintf(path, sizeof(path), "%s/left_raw.txt",     out_dir); DUMP_INT(path, left, AUDIO_SAMPLES);
-    snprintf(path, sizeof(path), "%s/right_raw.txt",    out_dir); DUMP_INT(path, right, AUDIO_SAMPLES);
+    add_n(audio_lpr_filter, audio_lmr_filter, n_audio, left);
+    sub_n(audio_lpr_filter, audio_lmr_filter, n_audio, right);
+    DUMP_INT(SIG_LEFT_RAW, left, n_audio);
+    DUMP_INT(SIG_RIGHT_RAW, right, n_audio);
 
     // De-emphasis
-    deemphasis_n(left,  deemph_l_x, deemph_l_y, AUDIO_SAMPLES, left_deemph);
-    deemphasis_n(right, deemph_r_x, deemph_r_y, AUDIO_SAMPLES, right_deemph);
-    snprintf(path, sizeof(path), "%s/left_deemph.txt",  out_dir); DUMP_INT(path, left_deemph, AUDIO_SAMPLES);
-    snprintf(path, sizeof(path), "%s/right_deemph.txt", out_dir); DUMP_INT(path, right_deemph, AUDIO_SAMPLES);
+    deemphasis_n(left,  deemph_l_x, deemph_l_y, n_audio, left_deemph);
+    deemphasis_n(right, deemph_r_x, deemph_r_y, n_audio, right_deemph);
+    DUMP_INT(SIG_LEFT_DEEMPH, left_deemph, n_audio);
+    DUMP_INT(SIG_RIGHT_DEEMPH, right_deemph, n_audio);
 
     // Volume control → final output
-    gain_n(left_deemph,  AUDIO_SAMPLES, VOLUME_LEVEL, left_audio);
-    gain_n(right_deemph, AUDIO_SAMPLES, VOLUME_LEVEL, right_audio);
-    snprintf(path, sizeof(path), "%s/out_left.txt",     out_dir); DUMP_INT(path, left_audio, AUDIO_SAMPLES);
-    snprintf(path, sizeof(path), "%s/out_right.txt",    out_dir); DUMP_INT(path, right_audio, AUDIO_SAMPLES);
+    gain_n(left_deemph,  n_audio, VOLUME_LEVEL, left_audio);
+    gain_n(right_deemph, n_audio, VOLUME_LEVEL, right_audio);
+    DUMP_INT(SIG_OUT_LEFT, left_audio, n_audio);
+    DUMP_INT(SIG_OUT_RIGHT, right_audio, n_audio);
+}
+
+// -d list: comma separated signal names, "all" for every signal
+static int select_signals(golden_opts *g, const char *list)
+{
+    char name[64];
+    memset(g->selected, 0, sizeof(g->selected));
+    while (*list) {
+        int len = (int)strcspn(list, ",");
+        snprintf(name, sizeof(name), "%.*s", len, list);
+        int found = 0;
+        for (int s = 0; s < N_SIGNALS; s++) {
+            if (strcmp(name, "all") == 0 || strcmp(name, signals[s].name) == 0) {
+                g->selected[s] = 1;
+                found = 1;
+            }
+        }
+        if (!found) { printf("Unknown signal: %s\n", name); return -1; }
+        list += len + (list[len] == ',');
+    }
+    return 0;
+}
+
+// fills IQ with up to max whole I/Q pairs, short only at the end of the input
+static int read_block(fm_input *in, unsigned char *IQ, int max)
+{
+    const uint8_t *block;
+    int got = 0, k;
+    while (got < max && (k = fm_input_next(in, max - got, &block)) > 0) {
+        memcpy(&IQ[4 * got], block, 4 * (size_t)k);
+        got += k;
+    }
+    return got;
+}
+
+static void usage()
+{
+    printf("Usage: fm_golden [-t] [-x] [-w start,length] [-d signals] <input.dat> <output_dir>\n");
+    printf("  -t  also write <signal>.txt (one %%d per line)\n");
+    printf("  -x  also write <signal>.hex ($readmemh)\n");
+    printf("  -w  dump only input samples [start, start+length); default the whole capture\n");
+    printf("  -d  comma separated signals to dump (default all):\n     ");
+    for (int s = 0; s < N_SIGNALS; s++) printf(" %s", signals[s].name);
+    printf("\n  e.g. fm_golden -t test/usrp.dat test\n");
+    printf("       fm_golden -w 1048576,65536 -d demod,pilot_38k test/usrp.dat test\n");
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 3) {
-        printf("Usage: fm_golden <input.dat> <output_dir>\n");
-        printf("  e.g. fm_golden test/usrp.dat test\n");
+    static golden_opts g;
+    int arg = 1;
+
+    g.length = -1;
+    for (int s = 0; s < N_SIGNALS; s++) g.selected[s] = 1;
+
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+        if (strcmp(argv[arg], "-t") == 0)      g.text = 1;
+        else if (strcmp(argv[arg], "-x") == 0) g.hex = 1;
+        else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+            if (sscanf(argv[++arg], "%lld,%lld", &g.start, &g.length) != 2 || g.start < 0 || g.length < 0) {
+                printf("Bad window: %s (start,length)\n", argv[arg]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            if (select_signals(&g, argv[++arg]) != 0) return -1;
+        }
+        else { arg = argc; break; }     // unknown option: usage
+    }
+
+    if (argc - arg < 2) {
+        usage();
         return -1;
     }
 
-    const char *input_file = argv[1];
-    const char *out_dir    = argv[2];
+    const char *input_file = argv[arg];
+    g.out_dir              = argv[arg + 1];
 
     static unsigned char IQ[SAMPLES * 4];
     static int left_audio[AUDIO_SAMPLES];
     static int right_audio[AUDIO_SAMPLES];
 
-    FILE *usrp_file = fopen(input_file, "rb");
-    if (!usrp_file) { printf("Cannot open %s\n", input_file); return -1; }
+    fm_input usrp_file;
+    if (fm_input_open(&usrp_file, input_file) != 0) return -1;
 
-    // Process only first batch for reference generation
-    size_t n = fread(IQ, sizeof(char), SAMPLES * 4, usrp_file);
-    fclose(usrp_file);
+    printf("Generating golden reference from: %s\n", input_file);
+    printf("Output directory: %s\n", g.out_dir);
+    if (g.length >= 0) printf("Window: input samples %lld..%lld\n", g.start, g.start + g.length);
+    printf("\n");
 
-    if (n < (size_t)(SAMPLES * 4)) {
-        printf("Warning: only read %zu / %d bytes\n", n, SAMPLES * 4);
-    }
+    if (open_dumps(&g) != 0) { fm_input_close(&usrp_file); return -1; }
 
-    printf("Generating golden reference from: %s\n", input_file);
-    printf("Output directory: %s\n\n", out_dir);
+    // whole capture, state carried from block to block; stop after the window
+    long long pos = 0;
+    const long long end = (g.length < 0) ? -1 : g.start + g.length;
+    int n;
+    while ((end < 0 || pos < end) && (n = read_block(&usrp_file, IQ, SAMPLES)) > 0) {
+        if (n % AUDIO_DECIM != 0) {
+            printf("Warning: dropping the last %d samples (not a whole audio sample)\n", n % AUDIO_DECIM);
+            n -= n % AUDIO_DECIM;
+            if (n == 0) break;
+        }
+        fm_radio_golden(IQ, n, pos, left_audio, right_audio, &g);
+        pos += n;
+    }
+    fm_input_close(&usrp_file);
 
-    fm_radio_golden(IQ, left_audio, right_audio, out_dir);
+    if (end > pos) {
+        printf("Warning: input ends at sample %lld, before the end of the window\n", pos);
+    }
+    close_dumps(&g);
 
-    printf("\nDone. Files written to %s/\n", out_dir);
+    printf("\nDone. %lld input samples processed, files written to %s/\n", pos, g.out_dir);
     return 0;
 }
@@ -0,0 +1,157 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "fm_radio.h"
+#include "fm_input.h"
+#include "fm_dump.h"
+#include "fm_rtl.h"
+
+// -------------------------------------------------------
+// fm_rtl: runs a capture through the cycle-approximate
+// model of fm_radio_top.sv (fm_rtl.h) and reports cycles
+// per audio sample, per-stage occupancy / stalls and FIFO
+// high-water marks. -o writes out_left.bin / out_right.bin
+// for fm_compare against the fm_golden dumps.
+// -------------------------------------------------------
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int dump( const char *dir, const char *name, const int *x, long n )
+{
+    char path[512];
+    fm_dump d;
+
+    snprintf( path, sizeof(path), "%s/%s.bin", dir, name );
+    // out_left / out_right come out of the gain stage in Q14
+    if ( fm_dump_open( &d, path, name, AUDIO_RATE, 14, 0 ) != 0 ) return -1;
+    fm_dump_write( &d, x, (int)n );
+    if ( fm_dump_close( &d ) != 0 )
+    {
+        printf( "Write failed on %s\n", path );
+        return -1;
+    }
+    printf( "  [dump] %s (%ld samples)\n", path, n );
+    return 0;
+}
+
+static void usage()
+{
+    printf( "Usage: fm_rtl [-c cycles] [-m macs] [-f depth] [-n samples] [-o dir] <input.dat>\n" );
+    printf( "  -c  clocks per input sample (default 1, back to back as in fm_radio_top_tb)\n" );
+    printf( "  -m  multipliers per FIR, 0 = one per tap as in fir.sv (default 0)\n" );
+    printf( "  -f  depth of every FIFO between the modules (default %d)\n", RTL_FIFO_DEPTH );
+    printf( "  -n  input samples to run (default the whole capture)\n" );
+    printf( "  -o  write out_left.bin / out_right.bin to dir\n" );
+    printf( "  e.g. fm_rtl -c 4 -m 8 -f 4 test/usrp.dat\n" );
+}
+
+int main( int argc, char **argv )
+{
+    rtl_config cfg = { 1, 0, RTL_FIFO_DEPTH };
+    long max_samples = -1;
+    const char *out_dir = NULL;
+    int arg = 1;
+
+    for ( ; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++ )
+    {
+        if ( strcmp(argv[arg], "-c") == 0 && arg + 1 < argc )
+        {
+            cfg.cycles_per_sample = atoi( argv[++arg] );
+        }
+        else if ( strcmp(argv[arg], "-m") == 0 && arg + 1 < argc )
+        {
+            cfg.fir_macs = atoi( argv[++arg] );
+        }
+        else if ( strcmp(argv[arg], "-f") == 0 && arg + 1 < argc )
+        {
+            cfg.fifo_depth = atoi( argv[++arg] );
+        }
+        else if ( strcmp(argv[arg], "-n") == 0 && arg + 1 < argc )
+        {
+            max_samples = atol( argv[++arg] );
+        }
+        else if ( strcmp(argv[arg], "-o") == 0 && arg + 1 < argc )
+        {
+            out_dir = argv[++arg];
+        }
+        else
+        {
+            usage();
+            return -1;
+        }
+    }
+    if ( arg != argc - 1 )
+    {
+        usage();
+        return -1;
+    }
+
+    // whole capture (or the first max_samples) unpacked up front
+    fm_input in;
+    if ( fm_input_open( &in, argv[arg] ) != 0 ) return -1;
+
+    std::vector<int> I, Q;
+    const uint8_t *block;
+    int m;
+    while ( (max_samples < 0 || (long)I.size() < max_samples) && (m = fm_input_next( &in, SAMPLES, &block )) > 0 )
+    {
+        if ( max_samples >= 0 && (long)I.size() + m > max_samples ) m = (int)(max_samples - (long)I.size());
+        const size_t at = I.size();
+        I.resize( at + m );
+        Q.resize( at + m );
+        read_IQ( block, &I[at], &Q[at], m );
+    }
+    fm_input_close( &in );
+
+    const long n = (long)I.size();
+    std::vector<int> left( n / AUDIO_DECIM + 1 ), right( n / AUDIO_DECIM + 1 );
+
+    FmRtlModel model( &cfg );
+    const double t0 = now_sec();
+    const long audio = model.run( I.data(), Q.data(), n, left.data(), right.data() );
+    const double elapsed = now_sec() - t0;
+
+    printf( "fm_rtl: %ld input samples, %d clock(s) per sample, %s FIR MACs, FIFO depth %d\n", n,
+            cfg.cycles_per_sample, cfg.fir_macs > 0 ? "folded" : "full", cfg.fifo_depth );
+    printf( "  simulated %ld cycles in %.3f s (%.1f M samples/s)\n", model.cycles(), elapsed, n / elapsed * 1e-6 );
+    printf( "  %ld audio samples, first at cycle %ld", audio, model.first_output() );
+    if ( audio > 1 )
+    {
+        printf( ", %.3f cycles per audio sample (steady state)",
+                (double)(model.last_output() - model.first_output()) / (audio - 1) );
+    }
+    printf( "\n  input: %ld stall cycles, worst sample %ld cycles late\n\n", model.source_stalls(),
+            model.max_input_delay() );
+
+    printf( "  %-14s %10s %10s %6s %10s %10s\n", "stage", "accepted", "produced", "busy%", "stalls", "starved" );
+    for ( int k = 0; k < model.n_stages(); k++ )
+    {
+        const RtlStage *s = model.stage( k );
+        printf( "  %-14s %10ld %10ld %6.1f %10ld %10ld\n", s->name, s->accepted, s->produced,
+                100.0 * s->busy_cycles / (model.cycles() ? model.cycles() : 1), s->stall_cycles, s->starve_cycles );
+    }
+
+    printf( "\n  %-16s %6s %6s %10s\n", "fifo", "depth", "high", "full" );
+    for ( int k = 0; k < model.n_fifos(); k++ )
+    {
+        const RtlFifo *f = model.fifo( k );
+        printf( "  %-16s %6d %6d %10ld\n", f->name, f->depth, f->high_water, f->full_cycles );
+    }
+
+    if ( out_dir != NULL )
+    {
+        printf( "\n" );
+        if ( dump( out_dir, "out_left", left.data(), audio ) != 0 ) return -1;
+        if ( dump( out_dir, "out_right", right.data(), audio ) != 0 ) return -1;
+    }
+    return 0;
+}